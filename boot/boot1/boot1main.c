@@ -55,8 +55,10 @@ uint32_t load_kernel(uint32_t dkernel)
     ph = (proghdr *) ((uint8_t *) ELFHDR + ELFHDR->e_phoff);
     eph = ph + ELFHDR->e_phnum;
 
+    // only the file-backed part of each segment is read; the kernel clears
+    // its own BSS (see seg_init), which may be far larger than the image
     for (; ph < eph; ph++) {
-        readsection(ph->p_va, ph->p_memsz, ph->p_offset, dkernel);
+        readsection(ph->p_va, ph->p_filesz, ph->p_offset, dkernel);
     }
 
     return (ELFHDR->e_entry & 0xFFFFFF);
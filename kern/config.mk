@@ -190,10 +190,43 @@ ifneq "$(strip $(DEBUG_VPIC) $(DEBUG_VDEV) $(DEBUG_HVM_ALL) $(DEBUG_ALL))" ""
 KERN_DEBUG_FLAGS	+= -DDEBUG_VPIC -DDEBUG_HVM -DDEBUG_MSG
 endif
 
+#
+# Kernel tunables.
+#
+
+# If set, give the buffer cache this many data pages instead of a share of
+# the free memory, e.g. BUFCACHE_PAGES=256 for 1024 buffers
+ifdef BUFCACHE_PAGES
+KERN_DEBUG_FLAGS	+= -DBUFCACHE_PAGES=$(BUFCACHE_PAGES)
+endif
+
+# If set, log at most this many sectors per transaction even if the on-disk
+# log holds more, e.g. LOG_CAPACITY=16 to compare log sizes on one image
+ifdef LOG_CAPACITY
+KERN_DEBUG_FLAGS	+= -DLOG_CAPACITY=$(LOG_CAPACITY)
+endif
+
+# If set, mount the file system in ordered mode: file data is written in
+# place before the metadata that points to it commits, and only metadata
+# goes through the log
+ifdef LOG_ORDERED
+KERN_DEBUG_FLAGS	+= -DLOG_ORDERED
+endif
+
 #
 # Performace trace switches.
 #
 
+# If set, collect per-lock and per-call-site spinlock statistics
+ifdef LOCKSTAT
+KERN_DEBUG_FLAGS	+= -DLOCKSTAT
+endif
+
+# If set, boot the APs and run the spinlock microbenchmark before the shell
+ifdef LOCKBENCH
+KERN_DEBUG_FLAGS	+= -DLOCKBENCH
+endif
+
 # If set, enable the basic trace of the virtualization module.
 ifneq "$(strip $(TRACE_VIRT) $(TRACE_VIRT_ALL))" ""
 KERN_DEBUG_FLAGS	+= -DTRACE_VIRT -DDEBUG_HVM -DDEBUG_MSG
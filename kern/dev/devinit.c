@@ -16,7 +16,6 @@
 #include <kern/dev/disk/ide.h>
 
 void intr_init(void);
-void bufcache_init(void);
 void inode_init(void);
 void file_init(void);
 
@@ -46,7 +45,6 @@ void devinit(uintptr_t mbi_addr)
 
     pmmap_init(mbi_addr);
 
-    bufcache_init();  // buffer cache
     file_init();      // file table
     inode_init();     // inode cache
     ide_init();
@@ -11,11 +11,14 @@
 
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
+// A queued buf may head a run of bufs for consecutive sectors, linked
+// through rnext, that is written with a single multi-sector command;
+// ide_cur is the buf of the run whose sector is being transferred.
 // You must hold ide_lk while manipulating queue.
 
 static spinlock_t ide_lk;
-spinlock_t fs_lock;
 static struct buf *idequeue;
+static struct buf *ide_cur;
 
 static int havedisk1;
 
@@ -37,7 +40,6 @@ void ide_init(void)
     int i;
 
     spinlock_init(&ide_lk);
-    spinlock_init(&fs_lock);
     picenable(IRQ_IDE1);
     ioapicenable(IRQ_IDE1, pcpu_ncpu() - 1);
     ide_wait(0);
@@ -60,18 +62,25 @@ void ide_init(void)
  */
 static void ide_start(struct buf *b)
 {
+    struct buf *r;
+    int nsec = 0;
+
     if (b == 0)
         KERN_PANIC("ide_start");
 
+    for (r = b; r != 0; r = r->rnext)
+        nsec++;
+
     ide_wait(0);
-    outb(0x3f6, 0);  // generate interrupt
-    outb(0x1f2, 1);  // number of sectors
+    outb(0x3f6, 0);     // generate interrupt
+    outb(0x1f2, nsec);  // number of sectors
     outb(0x1f3, b->sector & 0xff);
     outb(0x1f4, (b->sector >> 8) & 0xff);
     outb(0x1f5, (b->sector >> 16) & 0xff);
     outb(0x1f6, 0xe0 | ((b->dev & 1) << 4) | ((b->sector >> 24) & 0x0f));
     if (b->flags & B_DIRTY) {
         outb(0x1f7, IDE_CMD_WRITE);
+        ide_cur = b;
         outsl(0x1f0, b->data, 512 / 4);
     } else {
         outb(0x1f7, IDE_CMD_READ);
@@ -83,7 +92,7 @@ static void ide_start(struct buf *b)
  */
 void ide_intr(void)
 {
-    struct buf *b;
+    struct buf *b, *r;
 
     // First queued buffer is the active request.
     spinlock_acquire(&ide_lk);
@@ -92,6 +101,15 @@ void ide_intr(void)
         KERN_INFO("spurious IDE interrupt\n");
         return;
     }
+
+    // A write interrupts after every sector; send the next one of the run.
+    if ((b->flags & B_DIRTY) && ide_cur->rnext != 0) {
+        ide_cur = ide_cur->rnext;
+        ide_wait(0);
+        outsl(0x1f0, ide_cur->data, 512 / 4);
+        spinlock_release(&ide_lk);
+        return;
+    }
     idequeue = b->qnext;
 
     // Read data if needed.
@@ -99,8 +117,10 @@ void ide_intr(void)
         insl(0x1f0, b->data, 512 / 4);
 
     // Wake process waiting for this buf.
-    b->flags |= B_VALID;
-    b->flags &= ~B_DIRTY;
+    for (r = b; r != 0; r = r->rnext) {
+        r->flags |= B_VALID;
+        r->flags &= ~B_DIRTY;
+    }
     thread_wakeup(b);
 
     // Start disk on next buf in queue.
@@ -111,23 +131,13 @@ void ide_intr(void)
 }
 
 /**
- * Sync buf with disk.
- * If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
- * Else if B_VALID is not set, read buf from disk, set B_VALID.
+ * Queues the request headed by b and sleeps until it is done.
+ * Caller must hold ide_lk.
  */
-void ide_rw(struct buf *b)
+static void ide_submit(struct buf *b)
 {
     struct buf **pp;
 
-    if (!(b->flags & B_BUSY))
-        KERN_PANIC("ide_rw: buf not busy");
-    if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
-        KERN_PANIC("ide_rw: nothing to do");
-    if (b->dev != 0 && !havedisk1)
-        KERN_PANIC("ide_rw: ide disk 1 not present");
-
-    spinlock_acquire(&ide_lk);
-
     // Append b to idequeue.
     b->qnext = 0;
     for (pp = &idequeue; *pp; pp = &(*pp)->qnext)
@@ -142,6 +152,52 @@ void ide_rw(struct buf *b)
     while ((b->flags & (B_VALID | B_DIRTY)) != B_VALID) {
         thread_sleep(b, &ide_lk);
     }
+}
+
+/**
+ * Sync buf with disk.
+ * If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
+ * Else if B_VALID is not set, read buf from disk, set B_VALID.
+ */
+void ide_rw(struct buf *b)
+{
+    if (!mutex_holding(&b->lock))
+        KERN_PANIC("ide_rw: buf not locked");
+    if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
+        KERN_PANIC("ide_rw: nothing to do");
+    if (b->dev != 0 && !havedisk1)
+        KERN_PANIC("ide_rw: ide disk 1 not present");
+
+    spinlock_acquire(&ide_lk);
+    b->rnext = 0;
+    ide_submit(b);
+    spinlock_release(&ide_lk);
+}
+
+/**
+ * Writes the run of locked, dirty bufs headed by b and linked through
+ * rnext, which hold consecutive sectors of one device, with a single
+ * multi-sector command. Clears B_DIRTY on all of them.
+ */
+void ide_write_run(struct buf *b)
+{
+    struct buf *r;
+    int nsec = 0;
+
+    for (r = b; r != 0; r = r->rnext) {
+        if (!mutex_holding(&r->lock) || !(r->flags & B_DIRTY))
+            KERN_PANIC("ide_write_run: buf not locked or not dirty");
+        if (r->rnext != 0
+            && (r->rnext->dev != b->dev || r->rnext->sector != r->sector + 1))
+            KERN_PANIC("ide_write_run: sectors not consecutive");
+        nsec++;
+    }
+    if (nsec > IDE_MAX_RUN)
+        KERN_PANIC("ide_write_run: run too long");
+    if (b->dev != 0 && !havedisk1)
+        KERN_PANIC("ide_write_run: ide disk 1 not present");
 
+    spinlock_acquire(&ide_lk);
+    ide_submit(b);
     spinlock_release(&ide_lk);
 }
@@ -15,6 +15,8 @@
 #define IDE_CMD_READ  0x20
 #define IDE_CMD_WRITE 0x30
 
+#define IDE_MAX_RUN   255  // sectors per multi-sector write
+
 void ide_init(void);
 
 // Interrupt handler.
@@ -25,6 +27,10 @@ void ide_intr(void);
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
 void ide_rw(struct buf *b);
 
+// Write a run of locked, dirty bufs for consecutive sectors, linked
+// through rnext, with one command. Clears B_DIRTY on all of them.
+void ide_write_run(struct buf *b);
+
 void picenable(int32_t irq);
 void ioapicenable(int32_t irq, int cpunum);
 uint32_t pcpu_ncpu(void);
@@ -5,64 +5,172 @@
 #include "bufcache.h"
 #include "dinode.h"
 #include "log.h"
+#include "params.h"
+#include "block.h"
 
-// Read the super block.
+// Blocks a fresh run of allocations skips past: a file that started
+// a run grows into them, while other files start runs further on.
+#define BALLOC_RUN 32
+
+// In-memory state of a device's block allocator. The superblock never
+// changes once made, so it is read once. lock protects cursor and nfree;
+// the bitmap itself is protected by the locks of its buffers.
+struct balloc {
+    spinlock_t lock;
+    bool sbvalid;           // sb has been read
+    bool ready;             // nfree has been counted
+    struct superblock sb;
+    uint32_t cursor;        // where the next run of allocations starts
+    uint32_t nfree;         // number of free blocks
+};
+static struct balloc balloc[NDEV];
+
+static struct balloc *balloc_get(uint32_t dev)
+{
+    if (dev >= NDEV)
+        KERN_PANIC("balloc: bad device %d", dev);
+    return &balloc[dev];
+}
+
+// Read the super block. Refuses an image of another layout, whose inodes
+// would map the wrong blocks.
 void read_superblock(int dev, struct superblock *sb)
 {
+    struct balloc *ba = balloc_get(dev);
     struct buf *bp;
 
-    bp = bufcache_read(dev, 1);  // Block 1 is super block.
-    memmove(sb, bp->data, sizeof(*sb));
-    bufcache_release(bp);
+    if (!ba->sbvalid) {
+        bp = bufcache_read_meta(dev, 1);  // Block 1 is super block.
+        memmove(&ba->sb, bp->data, sizeof(ba->sb));
+        bufcache_release(bp);
+        if (ba->sb.magic != FSMAGIC)
+            KERN_PANIC("read_superblock: device %d has magic %x, not %x; "
+                       "rebuild the image for this layout",
+                       dev, ba->sb.magic, FSMAGIC);
+        ba->sbvalid = TRUE;
+    }
+    memmove(sb, &ba->sb, sizeof(*sb));
+}
+
+// Count the free blocks of device dev, once the log has been recovered.
+void block_init(uint32_t dev)
+{
+    struct balloc *ba = balloc_get(dev);
+    struct buf *bp;
+    struct superblock sb;
+    uint32_t b, bi, nfree, first;
+
+    read_superblock(dev, &sb);
+    nfree = 0;
+    first = sb.size;
+    for (b = 0; b < sb.size; b += BPB) {
+        bp = bufcache_read_meta(dev, BBLOCK(b, sb.ninodes));
+        for (bi = 0; bi < BPB && b + bi < sb.size; bi++) {
+            if ((bp->data[bi / 8] & (1 << (bi % 8))) == 0) {
+                if (first == sb.size)
+                    first = b + bi;
+                nfree++;
+            }
+        }
+        bufcache_release(bp);
+    }
+
+    spinlock_init(&ba->lock);
+    ba->nfree = nfree;
+    ba->cursor = first < sb.size ? first : 0;
+    ba->ready = TRUE;
+    KERN_INFO("[BSP KERN] Disk %d: %d of %d blocks free.\n",
+              dev, nfree, sb.size);
 }
 
-// Zero a block.
-void block_zero(uint32_t dev, uint32_t bno)
+// Zero a block. A file data block is zeroed in the cache alone: the
+// write that allocated it overwrites it next, and the bytes it leaves
+// lie past the end of the file, which is never read.
+void block_zero(uint32_t dev, uint32_t bno, bool data)
 {
     struct buf *bp;
 
-    bp = bufcache_read(dev, bno);
+    bp = bufcache_overwrite(dev, bno);
     memset(bp->data, 0, BSIZE);
-    log_write(bp);
+    if (!data)
+        log_write(bp);
     bufcache_release(bp);
 }
 
-// Allocate a zeroed disk block.
-uint32_t block_alloc(uint32_t dev)
+// Claim the first free block at or after start, wrapping around the end
+// of the disk. Whole bytes of the bitmap in use are skipped at once.
+static uint32_t balloc_claim(uint32_t dev, struct superblock *sb,
+                             uint32_t start)
 {
-    int b, bi, m;
     struct buf *bp;
-    struct superblock sb;
+    uint32_t b, bi, base, left;
+    int m;
 
-    bp = 0;
-    read_superblock(dev, &sb);
-    for (b = 0; b < sb.size; b += BPB) {
-        bp = bufcache_read(dev, BBLOCK(b, sb.ninodes));
-        for (bi = 0; bi < BPB && b + bi < sb.size; bi++) {
+    b = start;
+    for (left = sb->size; left > 0;) {
+        base = b - b % BPB;
+        bp = bufcache_read_meta(dev, BBLOCK(base, sb->ninodes));
+        for (; b < base + BPB && b < sb->size && left > 0; b++, left--) {
+            bi = b - base;
+            if (bi % 8 == 0 && bp->data[bi / 8] == 0xff
+                && b + 8 <= sb->size && left >= 8) {
+                b += 7;
+                left -= 7;
+                continue;
+            }
             m = 1 << (bi % 8);
             if ((bp->data[bi / 8] & m) == 0) {  // Is block free?
                 bp->data[bi / 8] |= m;          // Mark block in use.
                 log_write(bp);
                 bufcache_release(bp);
-                block_zero(dev, b + bi);
-                return b + bi;
+                return b;
             }
         }
         bufcache_release(bp);
+        if (b >= sb->size)
+            b = 0;
     }
     KERN_PANIC("balloc: out of blocks");
     return 0;
 }
 
+// Allocate a zeroed disk block, for file data if data is set, at goal if
+// it is free. Otherwise a new run starts at the allocation cursor.
+uint32_t block_alloc(uint32_t dev, bool data, uint32_t goal)
+{
+    struct balloc *ba = balloc_get(dev);
+    struct superblock *sb = &ba->sb;
+    uint32_t b, start;
+
+    if (!ba->ready)
+        KERN_PANIC("balloc: device %d not mounted", dev);
+
+    spinlock_acquire(&ba->lock);
+    if (ba->nfree == 0)
+        KERN_PANIC("balloc: out of blocks");
+    start = (goal > 0 && goal < sb->size) ? goal : ba->cursor;
+    spinlock_release(&ba->lock);
+
+    b = balloc_claim(dev, sb, start);
+
+    spinlock_acquire(&ba->lock);
+    ba->nfree--;
+    if (b != goal)
+        ba->cursor = (b + BALLOC_RUN) % sb->size;
+    spinlock_release(&ba->lock);
+
+    block_zero(dev, b, data);
+    return b;
+}
+
 // Free a disk block.
 void block_free(uint32_t dev, uint32_t b)
 {
+    struct balloc *ba = balloc_get(dev);
     struct buf *bp;
-    struct superblock sb;
     int bi, m;
 
-    read_superblock(dev, &sb);
-    bp = bufcache_read(dev, BBLOCK(b, sb.ninodes));
+    bp = bufcache_read_meta(dev, BBLOCK(b, ba->sb.ninodes));
     bi = b % BPB;
     m = 1 << (bi % 8);
     if ((bp->data[bi / 8] & m) == 0)
@@ -70,4 +178,9 @@ void block_free(uint32_t dev, uint32_t b)
     bp->data[bi / 8] &= ~m;
     log_write(bp);
     bufcache_release(bp);
+    log_free(dev, b);
+
+    spinlock_acquire(&ba->lock);
+    ba->nfree++;
+    spinlock_release(&ba->lock);
 }
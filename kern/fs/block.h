@@ -14,14 +14,21 @@
 
 #include "dinode.h"
 
-// Read the super block into sb.
+// Read the super block into sb. It is read from disk once per device.
 void read_superblock(int dev, struct superblock *sb);
 
-// Zero a block.
-void block_zero(uint32_t dev, uint32_t bno);
+// Count the free blocks of a device. Called once its log is recovered,
+// before any allocation.
+void block_init(uint32_t dev);
 
-// Allocate a zeroed disk block.
-uint32_t block_alloc(uint32_t dev);
+// Zero a block; one holding file data only in the cache.
+void block_zero(uint32_t dev, uint32_t bno, bool data);
+
+// Allocate a zeroed disk block. Set data if it is to hold file data,
+// which ordered journaling writes in place rather than to the log.
+// goal is the block to take if free, such as the one after the last
+// block of the file, or 0 to start a new run.
+uint32_t block_alloc(uint32_t dev, bool data, uint32_t goal);
 
 // Free a disk block.
 void block_free(uint32_t dev, uint32_t b);
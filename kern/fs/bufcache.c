@@ -1,107 +1,486 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents. Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
 // Interface:
-// * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * To get a buffer for a particular disk block, call bread, or
+//   bread_meta for file system metadata.
+// * After changing buffer data, call bwrite to mark it dirty; a flusher
+//   thread writes dirty buffers back in the background, and bflush waits
+//   until every dirty buffer has reached the disk.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //   so do not keep them longer than necessary.
 //
-// The implementation uses three state flags internally:
-// * B_BUSY: the block has been returned from bread
-//           and has not been passed back to brelse.
+// Buffers are found through a hash table keyed on (dev, sector). Only
+// clean, unpinned buffers sit on the replacement queues, which are
+// consulted to pick a buffer to recycle; dirty ones wait on the dirty
+// list instead. When no buffer can be recycled, lookups sleep until one
+// comes free.
+//
+// Replacement follows 2Q, so that one pass over a large file cannot wash
+// the metadata out of the cache. A block read in goes on probation, a
+// FIFO queue; only when it is referenced again, after enough other
+// releases that the references are not just consecutive reads of one
+// block, does it move to the protected queue, kept in LRU order. Victims
+// come from probation while it holds more than a quarter of the cache.
+// Metadata read with bread_meta is protected from the start.
+// The cache is sized at boot: PAGESIZE / BSIZE buffers share each data
+// page taken from the root container, and the hash table gets about one
+// bucket per buffer.
+//
+// Each buffer has a sleeping mutex, held from bread to brelse, and a
+// reference count that keeps it from being recycled while anyone holds or
+// waits for it. Three state flags describe the data:
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
 //            and needs to be written to disk.
+// * B_META: the buffer holds metadata and skips probation.
+// A pin count, taken by the log for every block of a transaction, keeps
+// a buffer in memory and away from the flusher until the log installs it.
 
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
+#include <kern/lib/gcc.h>
+#include <kern/lib/kstack.h>
 #include <kern/lib/spinlock.h>
+#include <kern/lib/string.h>
+#include <kern/lib/x86.h>
 #include <kern/lib/buf.h>
+#include <pmm/MContainer/export.h>
+#include <thread/PCurID/export.h>
 #include <thread/PThread/export.h>
 #include <dev/disk/ide.h>
+#include <dev/tsc.h>
 #include "params.h"
+#include "bufcache.h"
 
-struct {
+// Most hash buckets. There are as many as buffers, rounded up to a power
+// of two, so that chains stay short however large the cache is.
+#define NBUCKET_MAX (1 << 18)
+
+// Buffers sharing a data page.
+#define BUF_PER_PAGE (PAGESIZE / BSIZE)
+
+// Replacement queues.
+#define BQ_PROBATION 0  // referenced once, FIFO
+#define BQ_PROTECTED 1  // referenced again, LRU
+#define NQUEUE       2
+
+// Share of the buffers, in %, above which probation gives up the victims.
+// It is also the number of releases, in the same share of the buffers,
+// within which references to a buffer on probation count as one.
+#define PROBATION_SHARE 25
+
+// Write-back policy of the flusher thread.
+#define FLUSH_INTERVAL 100  // ms between two scans of the dirty list
+#define FLUSH_AGE      500  // ms a buffer may stay dirty
+#define DIRTY_RATIO    10   // % of dirty buffers that wakes the flusher early
+#define WB_BATCH       64   // buffers taken off the dirty list at once
+
+/**
+ * Each bucket lock protects its chain and the reference counts of the
+ * buffers on it, so a hit only takes the lock of its own bucket.
+ */
+struct bucket {
     spinlock_t lock;
-    struct buf buf[NBUF];
+    struct buf *head;  // chain through hnext
+};
+
+// Buckets sharing a page.
+#define BUCKET_PER_PAGE (PAGESIZE / sizeof(struct bucket))
 
-    // Linked list of all buffers, through prev/next.
-    // head.next is most recently used.
-    struct buf head;
+struct bufcache_cpu {
+    struct bufstat stat;  // only the lookup counters are used
+} gcc_aligned(64);
+
+/**
+ * lru_lock protects the replacement queues, the release clock and nwait,
+ * and serializes recycling. A recycler holds it while taking the buckets
+ * of both the old and the new block; lookups hold a single bucket lock,
+ * so this order cannot deadlock.
+ */
+struct {
+    spinlock_t lru_lock;
+
+    // The buckets, taken a page at a time from the root container as the
+    // pages need not be contiguous. nbucket is a power of two.
+    struct bucket *bucket[(NBUCKET_MAX + BUCKET_PER_PAGE - 1) / BUCKET_PER_PAGE];
+    uint32_t nbucket;
+
+    // The clean, unpinned buffers, on the queue named by their queue
+    // field, through prev/next, which are NULL for the others. head.next
+    // is the latest arrival.
+    struct buf head[NQUEUE];
+    uint32_t nqueued[NQUEUE];
+    uint32_t probation;  // probation size above which victims come from it
+    uint32_t clock;      // releases so far
+    uint32_t nwait;      // lookups sleeping on head for a buffer to recycle
+
+    uint32_t nbuf;    // buffers in the cache
+    uint32_t npages;  // pages holding their data and headers
+
+    // Dirty buffers waiting for write-back, through dprev/dnext, oldest
+    // first. dirty_lock protects the list and ndirty. flush_lock is held
+    // while writing back, so a flush barrier also waits for the batch the
+    // flusher may have in flight.
+    spinlock_t dirty_lock;
+    struct buf dirty;
+    uint32_t ndirty;
+    mutex_t flush_lock;
+
+    struct bufcache_cpu cpu[NUM_CPUS];
 } bcache;
 
-void bufcache_init(void)
+static gcc_inline struct bucket *bufcache_bucket(uint32_t dev, uint32_t sector)
+{
+    uint32_t i = (sector ^ (dev << 24)) & (bcache.nbucket - 1);
+
+    return &bcache.bucket[i / BUCKET_PER_PAGE][i % BUCKET_PER_PAGE];
+}
+
+/**
+ * Puts b at the head of its replacement queue.
+ * Called with lru_lock held.
+ */
+static void lru_push(struct buf *b)
 {
+    struct buf *head = &bcache.head[b->queue];
+
+    b->next = head->next;
+    b->prev = head;
+    head->next->prev = b;
+    head->next = b;
+    bcache.nqueued[b->queue]++;
+}
+
+/**
+ * Takes b off its replacement queue. Called with lru_lock held.
+ */
+static void lru_remove(struct buf *b)
+{
+    b->next->prev = b->prev;
+    b->prev->next = b->next;
+    b->next = b->prev = NULL;
+    bcache.nqueued[b->queue]--;
+}
+
+/**
+ * Accounts for a release of b, metadata if meta is set, whether it is
+ * queued or not. A buffer on probation stays in place, unless it holds
+ * metadata or it has outlived the correlated references that follow its
+ * first read; then it is protected. A protected buffer moves to the head
+ * of its queue. Called with lru_lock held.
+ */
+static void lru_touch(struct buf *b, bool meta)
+{
+    bool queued = b->next != NULL;
+
+    bcache.clock++;
+    if (b->queue == BQ_PROBATION && !meta
+        && bcache.clock - b->stamp <= bcache.probation)
+        return;
+    if (queued)
+        lru_remove(b);
+    b->queue = BQ_PROTECTED;
+    if (queued)
+        lru_push(b);
+}
+
+/**
+ * Returns locked buffer b to its replacement queue if it is clean and
+ * unpinned and not there already.
+ */
+static void lru_return(struct buf *b)
+{
+    if ((b->flags & B_DIRTY) || b->pincnt > 0)
+        return;
+    spinlock_acquire(&bcache.lru_lock);
+    if (b->next == NULL)
+        lru_push(b);
+    spinlock_release(&bcache.lru_lock);
+}
+
+/**
+ * Wakes up the lookups waiting for a buffer to recycle, after one may have
+ * come free.
+ */
+static void lru_kick(void)
+{
+    spinlock_acquire(&bcache.lru_lock);
+    if (bcache.nwait > 0)
+        thread_wakeup(bcache.head);
+    spinlock_release(&bcache.lru_lock);
+}
+
+/**
+ * Adds BUF_PER_PAGE unhashed buffers backed by a fresh page to the
+ * probation queue. Their headers are carved from a separate page shared by successive
+ * calls. Returns FALSE when the root container is out of pages.
+ */
+static bool bufcache_grow(void)
+{
+    static struct buf *hdrs;
+    static uint32_t nhdrs;
     struct buf *b;
+    uint8_t *data;
+    uint32_t page_index;
+    int i;
 
-    spinlock_init(&bcache.lock);
+    if (nhdrs < BUF_PER_PAGE) {
+        if ((page_index = container_alloc(0)) == 0)
+            return FALSE;
+        hdrs = (struct buf *) (page_index * PAGESIZE);
+        nhdrs = PAGESIZE / sizeof(struct buf);
+        bcache.npages++;
+    }
+    if ((page_index = container_alloc(0)) == 0)
+        return FALSE;
+    data = (uint8_t *) (page_index * PAGESIZE);
+    bcache.npages++;
 
-    // Create linked list of buffers
-    bcache.head.prev = &bcache.head;
-    bcache.head.next = &bcache.head;
-    for (b = bcache.buf; b < bcache.buf + NBUF; b++) {
-        b->next = bcache.head.next;
-        b->prev = &bcache.head;
+    for (i = 0; i < BUF_PER_PAGE; i++) {
+        b = hdrs++;
+        nhdrs--;
+        memset(b, 0, sizeof(*b));
+        b->data = data + i * BSIZE;
         b->dev = -1;
-        bcache.head.next->prev = b;
-        bcache.head.next = b;
+        mutex_init(&b->lock);
+        lru_push(b);
     }
+    bcache.nbuf += BUF_PER_PAGE;
+    return TRUE;
 }
 
 /**
- * Look through buffer cache for sector on device dev.
- * If not found, allocate fresh block.
- * In either case, return B_BUSY buffer.
+ * Sets up the smallest power of two of empty buckets, up to NBUCKET_MAX,
+ * that is at least nbuf.
  */
-static struct buf *bufcache_get(uint32_t dev, uint32_t sector)
+static void bufcache_buckets(uint32_t nbuf)
 {
-    struct buf *b;
+    struct bucket *page = NULL;
+    uint32_t page_index;
+    uint32_t i;
 
-    spinlock_acquire(&bcache.lock);
-
-loop:
-    // Is the sector already cached?
-    for (b = bcache.head.next; b != &bcache.head; b = b->next) {
-        if (b->dev == dev && b->sector == sector) {
-            if (!(b->flags & B_BUSY)) {
-                b->flags |= B_BUSY;
-                spinlock_release(&bcache.lock);
-                return b;
-            }
-            thread_sleep(b, &bcache.lock);
-            goto loop;
+    for (bcache.nbucket = 1;
+         bcache.nbucket < nbuf && bcache.nbucket < NBUCKET_MAX;
+         bcache.nbucket <<= 1);
+    for (i = 0; i < bcache.nbucket; i++) {
+        if (i % BUCKET_PER_PAGE == 0) {
+            if ((page_index = container_alloc(0)) == 0)
+                KERN_PANIC("bufcache_init: out of memory");
+            page = (struct bucket *) (page_index * PAGESIZE);
+            bcache.bucket[i / BUCKET_PER_PAGE] = page;
+            bcache.npages++;
         }
+        spinlock_init(&page[i % BUCKET_PER_PAGE].lock);
+        page[i % BUCKET_PER_PAGE].head = NULL;
+    }
+}
+
+/**
+ * Gives the buffer cache BUFCACHE_PAGES data pages if the kernel is built
+ * with that tunable, or 1 / BUFCACHE_SHARE of the free memory otherwise,
+ * but never less than NBUF buffers nor more than half of the free memory.
+ * Must run after the physical memory allocator is initialized.
+ */
+void bufcache_init(void)
+{
+    uint32_t nfree, npages;
+    int i;
+
+    spinlock_init_type(&bcache.lru_lock, SPINLOCK_TICKET);
+    spinlock_init(&bcache.dirty_lock);
+    mutex_init(&bcache.flush_lock);
+    bcache.dirty.dprev = &bcache.dirty;
+    bcache.dirty.dnext = &bcache.dirty;
+    for (i = 0; i < NQUEUE; i++) {
+        bcache.head[i].prev = &bcache.head[i];
+        bcache.head[i].next = &bcache.head[i];
+        bcache.nqueued[i] = 0;
     }
+    bcache.clock = 0;
+    bcache.nwait = 0;
 
-    // Not cached; recycle some non-busy and clean buffer.
-    for (b = bcache.head.prev; b != &bcache.head; b = b->prev) {
-        if ((b->flags & B_BUSY) == 0 && (b->flags & B_DIRTY) == 0) {
+    nfree = container_get_quota(0) - container_get_usage(0);
+#ifdef BUFCACHE_PAGES
+    npages = BUFCACHE_PAGES;
+#else
+    npages = nfree / BUFCACHE_SHARE;
+#endif
+    if (npages > nfree / 2)
+        npages = nfree / 2;
+    if (npages < (NBUF + BUF_PER_PAGE - 1) / BUF_PER_PAGE)
+        npages = (NBUF + BUF_PER_PAGE - 1) / BUF_PER_PAGE;
+
+    bufcache_buckets(npages * BUF_PER_PAGE);
+    while (bcache.nbuf < npages * BUF_PER_PAGE && bufcache_grow());
+    if (bcache.nbuf < NBUF)
+        KERN_PANIC("bufcache_init: out of memory");
+    bcache.probation = bcache.nbuf * PROBATION_SHARE / 100;
+
+    KERN_INFO("[BSP KERN] Buffer cache: %d buffers, %d buckets in %d KB.\n",
+              bcache.nbuf, bcache.nbucket, bcache.npages * (PAGESIZE / 1024));
+}
+
+/**
+ * Looks for sector on device dev in bucket bkt, whose lock is held.
+ * Adds the number of buffers examined to *probes.
+ */
+static struct buf *bucket_find(struct bucket *bkt, uint32_t dev,
+                               uint32_t sector, uint32_t *probes)
+{
+    struct buf *b;
+
+    for (b = bkt->head; b != NULL; b = b->hnext) {
+        (*probes)++;
+        if (b->dev == dev && b->sector == sector)
+            return b;
+    }
+    return NULL;
+}
+
+static void bucket_remove(struct bucket *bkt, struct buf *b)
+{
+    struct buf **pp;
+
+    for (pp = &bkt->head; *pp != b; pp = &(*pp)->hnext);
+    *pp = b->hnext;
+    b->hnext = NULL;
+}
+
+/**
+ * Takes the buffer nearest to the tail of queue q that is not referenced
+ * off its old bucket, and rehashes it as sector on device dev into bkt,
+ * on probation. Called with lru_lock and the lock of bkt held.
+ */
+static struct buf *queue_recycle(int q, struct bucket *bkt, uint32_t dev,
+                                 uint32_t sector)
+{
+    struct buf *head = &bcache.head[q];
+    struct buf *b;
+    struct bucket *old;
+
+    for (b = head->prev; b != head; b = b->prev) {
+        old = b->dev == -1 ? NULL : bufcache_bucket(b->dev, b->sector);
+        if (old != NULL && old != bkt)
+            spinlock_acquire(&old->lock);
+        if (b->refcnt == 0 && !(b->flags & B_DIRTY) && b->pincnt == 0) {
+            if (old != NULL)
+                bucket_remove(old, b);
+            if (old != NULL && old != bkt)
+                spinlock_release(&old->lock);
             b->dev = dev;
             b->sector = sector;
-            b->flags = B_BUSY;
-            spinlock_release(&bcache.lock);
+            b->flags = 0;
+            b->refcnt = 1;
+            b->hnext = bkt->head;
+            bkt->head = b;
+            lru_remove(b);
+            b->queue = BQ_PROBATION;
+            b->stamp = bcache.clock;
+            lru_push(b);
             return b;
         }
+        if (old != NULL && old != bkt)
+            spinlock_release(&old->lock);
     }
-    KERN_PANIC("bufcache_get: no buffers");
     return NULL;
 }
 
 /**
- * Return a B_BUSY buf with the contents of the indicated disk sector.
+ * Recycles a buffer for sector on device dev, from probation while it
+ * holds more than its share of the cache, from the protected queue
+ * otherwise, or from whichever queue has a buffer to spare.
+ * Called with lru_lock and the lock of bkt held.
+ */
+static struct buf *bufcache_recycle(struct bucket *bkt, uint32_t dev,
+                                    uint32_t sector)
+{
+    struct buf *b;
+    int q;
+
+    q = bcache.nqueued[BQ_PROBATION] > bcache.probation
+        || bcache.nqueued[BQ_PROTECTED] == 0 ? BQ_PROBATION : BQ_PROTECTED;
+    if ((b = queue_recycle(q, bkt, dev, sector)) == NULL)
+        b = queue_recycle(!q, bkt, dev, sector);
+    return b;
+}
+
+/**
+ * Look through buffer cache for sector on device dev.
+ * If not found, allocate fresh block.
+ * In either case, return the buffer locked.
+ * Lookups of metadata, if meta is set, are counted apart as well.
+ */
+static struct buf *bufcache_get(uint32_t dev, uint32_t sector, bool meta)
+{
+    struct bufstat *stat = &bcache.cpu[get_kstack_cpu_idx()].stat;
+    struct bucket *bkt = bufcache_bucket(dev, sector);
+    struct buf *b;
+    uint32_t probes = 0;
+    uint64_t start = rdtsc();
+
+    spinlock_acquire(&bkt->lock);
+    b = bucket_find(bkt, dev, sector, &probes);
+    if (b != NULL) {
+        b->refcnt++;
+        spinlock_release(&bkt->lock);
+        stat->hits++;
+        stat->meta_hits += meta;
+        goto found;
+    }
+    spinlock_release(&bkt->lock);
+
+    spinlock_acquire(&bcache.lru_lock);
+    while (1) {
+        spinlock_acquire(&bkt->lock);
+
+        // Look again, it may have been cached meanwhile.
+        b = bucket_find(bkt, dev, sector, &probes);
+        if (b != NULL) {
+            b->refcnt++;
+            stat->hits++;
+            stat->meta_hits += meta;
+            break;
+        }
+        if ((b = bufcache_recycle(bkt, dev, sector)) != NULL) {
+            stat->misses++;
+            stat->meta_misses += meta;
+            break;
+        }
+        spinlock_release(&bkt->lock);
+
+        // Every buffer is in use, dirty or pinned. Let the flusher clean
+        // some and wait for one to come free.
+        stat->waits++;
+        bcache.nwait++;
+        thread_wakeup(&bcache.dirty);
+        thread_sleep(bcache.head, &bcache.lru_lock);
+        bcache.nwait--;
+    }
+    spinlock_release(&bkt->lock);
+    spinlock_release(&bcache.lru_lock);
+
+  found:
+    stat->probes += probes;
+    stat->cycles += rdtsc() - start;
+    mutex_lock(&b->lock);
+    return b;
+}
+
+/**
+ * Return a locked buf with the contents of the indicated disk sector.
  */
 struct buf *bufcache_read(uint32_t dev, uint32_t sector)
 {
     struct buf *b;
 
-    b = bufcache_get(dev, sector);
+    b = bufcache_get(dev, sector, FALSE);
     if (!(b->flags & B_VALID)) {
         ide_rw(b);
     }
@@ -109,37 +488,307 @@ struct buf *bufcache_read(uint32_t dev, uint32_t sector)
 }
 
 /**
- * Write b's contents to disk. Must be B_BUSY.
+ * Like bufcache_read, for a block of file system metadata, which the
+ * cache then keeps in preference to file data.
+ */
+struct buf *bufcache_read_meta(uint32_t dev, uint32_t sector)
+{
+    struct buf *b;
+
+    b = bufcache_get(dev, sector, TRUE);
+    b->flags |= B_META;
+    if (!(b->flags & B_VALID)) {
+        ide_rw(b);
+    }
+    return b;
+}
+
+/**
+ * Return a locked buf for sector on device dev, whose data the caller
+ * overwrites whole before marking it dirty, so a miss does not read the
+ * disk.
+ */
+struct buf *bufcache_overwrite(uint32_t dev, uint32_t sector)
+{
+    struct buf *b;
+
+    b = bufcache_get(dev, sector, FALSE);
+    b->flags |= B_VALID;
+    return b;
+}
+
+/**
+ * Mark b dirty; the flusher writes it back later. Must be locked.
+ * Call bufcache_flush to wait until it reaches the disk.
  */
 void bufcache_write(struct buf *b)
 {
-    if ((b->flags & B_BUSY) == 0)
+    bool kick;
+
+    if (!mutex_holding(&b->lock))
         KERN_PANIC("bwrite");
 
+    spinlock_acquire(&bcache.lru_lock);
+    if (b->next != NULL)
+        lru_remove(b);
+    spinlock_release(&bcache.lru_lock);
+
+    spinlock_acquire(&bcache.dirty_lock);
     b->flags |= B_DIRTY;
-    ide_rw(b);
+    if (b->dnext == NULL) {
+        b->dirtied = rdtsc();
+        b->dnext = &bcache.dirty;
+        b->dprev = bcache.dirty.dprev;
+        bcache.dirty.dprev->dnext = b;
+        bcache.dirty.dprev = b;
+        bcache.ndirty++;
+    }
+    kick = bcache.ndirty * 100 > bcache.nbuf * DIRTY_RATIO;
+    spinlock_release(&bcache.dirty_lock);
+
+    if (kick)
+        thread_wakeup(&bcache.dirty);
+}
+
+/**
+ * Drops the reference and the lock the write-back took on b. If b is clean
+ * now, it goes back to its queue, where waiting lookups may take it.
+ */
+static void bufcache_drop(struct buf *b)
+{
+    struct bucket *bkt = bufcache_bucket(b->dev, b->sector);
+
+    lru_return(b);
+    mutex_unlock(&b->lock);
+    spinlock_acquire(&bkt->lock);
+    b->refcnt--;
+    spinlock_release(&bkt->lock);
+    lru_kick();
 }
 
 /**
- * Release a B_BUSY buffer.
- * Move to the head of the MRU list.
+ * Writes the locked bufs batch[0..n), sorted by (dev, sector), merging
+ * consecutive sectors into multi-sector disk commands.
+ */
+static void bufcache_write_runs(struct buf **batch, uint32_t n)
+{
+    uint32_t i, j;
+
+    for (i = 0; i < n; i = j) {
+        batch[i]->rnext = NULL;
+        for (j = i + 1; j < n && j - i < IDE_MAX_RUN; j++) {
+            if (batch[j]->dev != batch[i]->dev
+                || batch[j]->sector != batch[j - 1]->sector + 1)
+                break;
+            batch[j - 1]->rnext = batch[j];
+            batch[j]->rnext = NULL;
+        }
+        ide_write_run(batch[i]);
+    }
+}
+
+/**
+ * Takes up to WB_BATCH buffers that have been dirty for at least [age] TSC
+ * ticks off the head of the dirty list and writes them back in sector
+ * order. Buffers whose lock is free are written together in coalesced
+ * runs; the others are waited for one at a time afterwards, holding no
+ * other buffer, so that a process holding several buffers cannot deadlock
+ * with the write-back. Must be called with flush_lock held.
+ * Returns the number of buffers taken off the list.
+ */
+static uint32_t bufcache_writeback(uint64_t age)
+{
+    struct buf *batch[WB_BATCH], *busy[WB_BATCH], *b;
+    struct bucket *bkt;
+    uint64_t now = rdtsc();
+    uint32_t n = 0, nlocked = 0, nbusy = 0, i, j;
+
+    spinlock_acquire(&bcache.dirty_lock);
+    while (n < WB_BATCH && (b = bcache.dirty.dnext) != &bcache.dirty
+           && now - b->dirtied >= age) {
+        b->dnext->dprev = &bcache.dirty;
+        bcache.dirty.dnext = b->dnext;
+        b->dnext = b->dprev = NULL;
+        bcache.ndirty--;
+
+        // Dirty buffers are never recycled, so b stays in this bucket.
+        bkt = bufcache_bucket(b->dev, b->sector);
+        spinlock_acquire(&bkt->lock);
+        b->refcnt++;
+        spinlock_release(&bkt->lock);
+
+        // Insert in (dev, sector) order.
+        for (i = n; i > 0 && (batch[i - 1]->dev > b->dev
+                              || (batch[i - 1]->dev == b->dev
+                                  && batch[i - 1]->sector > b->sector)); i--)
+            batch[i] = batch[i - 1];
+        batch[i] = b;
+        n++;
+    }
+    spinlock_release(&bcache.dirty_lock);
+
+    // Buffers that are clean by now were written already, and pinned ones
+    // are dirtied again when the log installs them.
+    for (i = 0, j = 0; i < n; i++) {
+        b = batch[i];
+        if (!mutex_trylock(&b->lock)) {
+            busy[nbusy++] = b;
+        } else if (!(b->flags & B_DIRTY) || b->pincnt > 0) {
+            bufcache_drop(b);
+        } else {
+            batch[j++] = b;
+        }
+    }
+    nlocked = j;
+    bufcache_write_runs(batch, nlocked);
+    for (i = 0; i < nlocked; i++)
+        bufcache_drop(batch[i]);
+
+    for (i = 0; i < nbusy; i++) {
+        b = busy[i];
+        mutex_lock(&b->lock);
+        if ((b->flags & B_DIRTY) && b->pincnt == 0)
+            ide_rw(b);
+        bufcache_drop(b);
+    }
+
+    return n;
+}
+
+/**
+ * Flush barrier: returns once every buffer marked dirty before the call
+ * has been written to the disk.
+ */
+void bufcache_flush(void)
+{
+    mutex_lock(&bcache.flush_lock);
+    while (bufcache_writeback(0) > 0);
+    mutex_unlock(&bcache.flush_lock);
+}
+
+/**
+ * The flusher thread. Every FLUSH_INTERVAL ms, or as soon as more than
+ * DIRTY_RATIO % of the buffers are dirty, writes back the buffers dirty
+ * for longer than FLUSH_AGE ms, then the oldest ones until at most half
+ * of DIRTY_RATIO % remain.
+ */
+static void bufcache_flusher(void)
+{
+    uint64_t age = tsc_per_ms * FLUSH_AGE;
+
+    spinlock_acquire(&bcache.dirty_lock);
+    while (1) {
+        thread_sleep_timeout(&bcache.dirty, &bcache.dirty_lock, FLUSH_INTERVAL);
+        spinlock_release(&bcache.dirty_lock);
+
+        mutex_lock(&bcache.flush_lock);
+        while (bufcache_writeback(age) == WB_BATCH);
+        while (bcache.ndirty * 200 > bcache.nbuf * DIRTY_RATIO
+               && bufcache_writeback(0) > 0);
+        mutex_unlock(&bcache.flush_lock);
+
+        spinlock_acquire(&bcache.dirty_lock);
+    }
+}
+
+/**
+ * Starts the flusher thread as a child of the current process.
+ */
+void bufcache_start_flusher(void)
+{
+    if (thread_spawn(bufcache_flusher, get_curid(), 0) == NUM_IDS)
+        KERN_PANIC("bufcache_start_flusher: cannot spawn the flusher");
+}
+
+/**
+ * Release a locked buffer.
+ * Counts as a reference for the replacement queues.
  */
 void bufcache_release(struct buf *b)
 {
-    if ((b->flags & B_BUSY) == 0)
+    struct bucket *bkt;
+    bool meta;
+
+    if (!mutex_holding(&b->lock))
         KERN_PANIC("brelse");
 
-    spinlock_acquire(&bcache.lock);
+    meta = (b->flags & B_META) != 0;
+    mutex_unlock(&b->lock);
 
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    // Our reference keeps b in this bucket until it is dropped.
+    bkt = bufcache_bucket(b->dev, b->sector);
+    spinlock_acquire(&bkt->lock);
+    b->refcnt--;
+    spinlock_release(&bkt->lock);
+
+    // If b is recyclable it is on a queue; a lookup may be waiting for it.
+    spinlock_acquire(&bcache.lru_lock);
+    lru_touch(b, meta);
+    if (bcache.nwait > 0)
+        thread_wakeup(bcache.head);
+    spinlock_release(&bcache.lru_lock);
+}
+
+/**
+ * Pin locked buffer b: it stays in memory, and is neither written back
+ * nor recycled, until the matching bufcache_unpin.
+ */
+void bufcache_pin(struct buf *b)
+{
+    if (!mutex_holding(&b->lock))
+        KERN_PANIC("bufcache_pin");
+
+    if (b->pincnt++ == 0) {
+        spinlock_acquire(&bcache.lru_lock);
+        if (b->next != NULL)
+            lru_remove(b);
+        spinlock_release(&bcache.lru_lock);
+    }
+}
+
+/**
+ * Drop a pin of locked buffer b. Once unpinned, a dirty b is queued for
+ * write-back again and a clean one becomes recyclable.
+ */
+void bufcache_unpin(struct buf *b)
+{
+    if (!mutex_holding(&b->lock) || b->pincnt == 0)
+        KERN_PANIC("bufcache_unpin");
 
-    b->flags &= ~B_BUSY;
-    thread_wakeup(b);
+    if (--b->pincnt > 0)
+        return;
+    if (b->flags & B_DIRTY)
+        bufcache_write(b);
+    else
+        lru_return(b);
+}
+
+/**
+ * Sums the lookup statistics of all CPUs into *stat, along with the size
+ * of the cache.
+ */
+void bufcache_get_stat(struct bufstat *stat)
+{
+    int i;
+
+    memset(stat, 0, sizeof(*stat));
+    stat->nbuf = bcache.nbuf;
+    stat->npages = bcache.npages;
+    for (i = 0; i < NUM_CPUS; i++) {
+        stat->hits += bcache.cpu[i].stat.hits;
+        stat->misses += bcache.cpu[i].stat.misses;
+        stat->probes += bcache.cpu[i].stat.probes;
+        stat->waits += bcache.cpu[i].stat.waits;
+        stat->meta_hits += bcache.cpu[i].stat.meta_hits;
+        stat->meta_misses += bcache.cpu[i].stat.meta_misses;
+        stat->cycles += bcache.cpu[i].stat.cycles;
+    }
+}
+
+void bufcache_reset_stat(void)
+{
+    int i;
 
-    spinlock_release(&bcache.lock);
+    for (i = 0; i < NUM_CPUS; i++)
+        memset(&bcache.cpu[i].stat, 0, sizeof(bcache.cpu[i].stat));
 }
@@ -1,24 +1,35 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents. Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * After changing buffer data, call bwrite to mark it dirty; a flusher
+//   thread writes dirty buffers back in the background, and bflush waits
+//   until every dirty buffer has reached the disk.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //   so do not keep them longer than necessary.
 //
-// The implementation uses three state flags internally:
-// * B_BUSY: the block has been returned from bread
-//           and has not been passed back to brelse.
+// Buffers are found through a hash table keyed on (dev, sector). Only
+// clean, unpinned buffers sit on the LRU list, which is consulted to
+// pick a buffer to recycle; dirty ones wait on the dirty list instead.
+// When no buffer can be recycled, lookups sleep until one comes free.
+// The cache is sized at boot: PAGESIZE / BSIZE buffers share each data
+// page taken from the root container.
+//
+// Each buffer has a sleeping mutex, held from bread to brelse, and a
+// reference count that keeps it from being recycled while anyone holds or
+// waits for it. Three state flags describe the data:
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
 //            and needs to be written to disk.
+// A pin count, taken by the log for every block of a transaction, keeps
+// a buffer in memory and away from the flusher until the log installs it.
 
 #ifndef _KERN_FS_BUFCACHE_H_
 #define _KERN_FS_BUFCACHE_H_
@@ -26,26 +37,68 @@
 #ifdef _KERN_
 
 #include <kern/lib/buf.h>
+#include <kern/lib/syscall.h>
 #include "params.h"
 
+/**
+ * Sizes the cache from the free memory, or from the BUFCACHE_PAGES
+ * tunable. Must run after the physical memory allocator is initialized.
+ */
 void bufcache_init(void);
 
 /**
- * Return a B_BUSY buf with the contents of the indicated disk sector.
+ * Return a locked buf with the contents of the indicated disk sector.
  */
 struct buf *bufcache_read(uint32_t dev, uint32_t sector);
 
 /**
- * Write b's contents to disk.  Must be B_BUSY.
+ * Like bufcache_read, for a metadata block: the superblock, a bitmap or
+ * an inode block. The cache keeps those in preference to file data.
+ */
+struct buf *bufcache_read_meta(uint32_t dev, uint32_t sector);
+
+/**
+ * Return a locked buf for a sector the caller overwrites whole, without
+ * reading it from the disk.
+ */
+struct buf *bufcache_overwrite(uint32_t dev, uint32_t sector);
+
+/**
+ * Mark b dirty; the flusher writes it back later. Must be locked.
  */
 void bufcache_write(struct buf *b);
 
 /**
- * Release a B_BUSY buffer.
- * Move to the head of the MRU list.
+ * Pin a locked buffer in memory, away from write-back and recycling,
+ * until the matching bufcache_unpin. Pins nest.
+ */
+void bufcache_pin(struct buf *b);
+void bufcache_unpin(struct buf *b);
+
+/**
+ * Flush barrier: returns once every buffer marked dirty before the call
+ * has been written to the disk.
+ */
+void bufcache_flush(void);
+
+/**
+ * Starts the flusher thread, once processes can be scheduled.
+ */
+void bufcache_start_flusher(void);
+
+/**
+ * Release a locked buffer.
+ * Counts as a reference for the replacement queues.
  */
 void bufcache_release(struct buf *b);
 
+/**
+ * Sums the lookup statistics of all CPUs into *stat, along with the size
+ * of the cache.
+ */
+void bufcache_get_stat(struct bufstat *stat);
+void bufcache_reset_stat(void);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_FS_BUFCACHE_H_ */
@@ -0,0 +1,94 @@
+#include <kern/lib/types.h>
+#include <kern/lib/debug.h>
+#include <kern/lib/string.h>
+#include <kern/lib/spinlock.h>
+#include "params.h"
+#include "inode.h"
+#include "dir.h"
+#include "dcache.h"
+
+// Entries of a set, probed on every lookup.
+#define DCACHE_WAYS 4
+#define NDSET       (NDENTRY / DCACHE_WAYS)
+
+struct dentry {
+    uint32_t dev;
+    uint32_t parent;  // inode number of the directory, 0 if unused
+    uint32_t child;   // inode number name refers to, 0 if none
+    uint32_t stamp;   // time of the last use
+    char name[DIRSIZ];
+};
+
+struct {
+    spinlock_t lock;
+    uint32_t clock;
+    struct dentry set[NDSET][DCACHE_WAYS];
+} dcache;
+
+static struct dentry *dcache_set(uint32_t dev, uint32_t inum, char *name)
+{
+    return dcache.set[(dir_hash(name) ^ (inum * 2654435761u) ^ dev) % NDSET];
+}
+
+// The entry of set for (dev, inum, name), or 0. Called with dcache.lock.
+static struct dentry *dcache_find(struct dentry *set, uint32_t dev,
+                                  uint32_t inum, char *name)
+{
+    int i;
+
+    for (i = 0; i < DCACHE_WAYS; i++)
+        if (set[i].parent == inum && set[i].dev == dev
+            && dir_namecmp(set[i].name, name) == 0)
+            return &set[i];
+    return 0;
+}
+
+bool dcache_lookup(uint32_t dev, uint32_t inum, char *name,
+                   struct inode **ipp)
+{
+    struct dentry *de;
+
+    spinlock_acquire(&dcache.lock);
+    de = dcache_find(dcache_set(dev, inum, name), dev, inum, name);
+    if (de != 0) {
+        de->stamp = ++dcache.clock;
+        *ipp = de->child != 0 ? inode_get(dev, de->child) : 0;
+    }
+    spinlock_release(&dcache.lock);
+    return de != 0;
+}
+
+void dcache_enter(uint32_t dev, uint32_t inum, char *name, uint32_t child)
+{
+    struct dentry *set, *de;
+    int i;
+
+    spinlock_acquire(&dcache.lock);
+    set = dcache_set(dev, inum, name);
+    if ((de = dcache_find(set, dev, inum, name)) == 0) {
+        // Replace an unused entry, or else the least recently used.
+        de = &set[0];
+        for (i = 1; i < DCACHE_WAYS && de->parent != 0; i++)
+            if (set[i].parent == 0 || set[i].stamp < de->stamp)
+                de = &set[i];
+        de->dev = dev;
+        de->parent = inum;
+        strncpy(de->name, name, DIRSIZ);
+    }
+    de->child = child;
+    de->stamp = ++dcache.clock;
+    spinlock_release(&dcache.lock);
+}
+
+void dcache_purge(uint32_t dev, uint32_t inum)
+{
+    int i, j;
+
+    spinlock_acquire(&dcache.lock);
+    for (i = 0; i < NDSET; i++)
+        for (j = 0; j < DCACHE_WAYS; j++)
+            if (dcache.set[i][j].dev == dev
+                && dcache.set[i][j].parent == inum)
+                dcache.set[i][j].parent = 0;
+    spinlock_release(&dcache.lock);
+}
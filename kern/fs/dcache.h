@@ -0,0 +1,41 @@
+// Directory entry cache.
+//
+// The dentry cache remembers what names looked up in directories refer
+// to, keyed on (device, directory inode number, name), so that path
+// lookup can go through directories it has seen recently without locking
+// them or reading their blocks. A negative entry, with an inode number of
+// zero, records that the name does not exist.
+//
+// Entries are filled in by dir_lookup and kept up to date by dir_link and
+// dir_unlink, under the lock of the directory. dir_unlink makes an entry
+// negative before the link count of its inode drops, so a hit may take a
+// reference to the inode. Those of a directory are purged when its inode
+// is freed, as its number may be reused. The cache is set associative,
+// with the least recently used entry of a set replaced, so a lookup
+// costs a hash and a few probes.
+
+#ifndef _KERN_FS_DCACHE_H_
+#define _KERN_FS_DCACHE_H_
+
+#ifdef _KERN_
+
+struct inode;
+
+// Look up name in directory inum of device dev. If the cache knows the
+// answer, returns TRUE and sets *ipp to a reference to the inode name
+// refers to, or to 0 if name does not exist. The reference is taken
+// under the cache lock, so the entry cannot be unlinked and the inode
+// freed in between.
+bool dcache_lookup(uint32_t dev, uint32_t inum, char *name,
+                   struct inode **ipp);
+
+// Record that name in directory inum refers to inode child, or to
+// nothing if child is 0.
+void dcache_enter(uint32_t dev, uint32_t inum, char *name, uint32_t child);
+
+// Forget the entries of directory inum, which is being freed.
+void dcache_purge(uint32_t dev, uint32_t inum);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_FS_DCACHE_H_ */
@@ -3,9 +3,11 @@
 
 #ifdef _KERN_
 
-#define NDIRECT   12
+#define NDIRECT   10
 #define NINDIRECT (BSIZE / sizeof(uint32_t))
-#define MAXFILE   (NDIRECT + NINDIRECT)
+#define NLEVELS   3  // single, double and triple indirect blocks
+#define MAXFILE   (NDIRECT + NINDIRECT + NINDIRECT * NINDIRECT \
+                   + NINDIRECT * NINDIRECT * NINDIRECT)
 
 // On-disk inode structure
 struct dinode {
@@ -14,10 +16,9 @@ struct dinode {
     int16_t minor;                // Minor device number (T_DEV only)
     int16_t nlink;                // Number of links to inode in file system
     uint32_t size;                // Size of file (bytes)
-    uint32_t addrs[NDIRECT + 1];  // Data block addresses
+    uint32_t addrs[NDIRECT + NLEVELS];  // Data block addresses
 };
 
-#define I_BUSY  0x1
 #define I_VALID 0x2
 
 // Inodes per block.
@@ -32,12 +33,18 @@ struct dinode {
 // Block containing bit for block b
 #define BBLOCK(b, ninodes) (b / BPB + (ninodes) / IPB + 3)
 
+// Magic number of the super block of an image laid out as above, with
+// NDIRECT direct blocks followed by NLEVELS indirect ones. Images from
+// before the double and triple indirect blocks lack it.
+#define FSMAGIC 0x33444e49  // "IND3"
+
 // File system super block
 struct superblock {
     size_t size;       // Size of file system image (blocks)
     uint32_t nblocks;  // Number of data blocks
     uint32_t ninodes;  // Number of inodes
     uint32_t nlog;     // Number of log blocks
+    uint32_t magic;    // FSMAGIC
 };
 
 #endif  /* _KERN_ */
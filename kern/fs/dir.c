@@ -1,8 +1,11 @@
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
 #include <kern/lib/string.h>
+#include "bufcache.h"
+#include "log.h"
 #include "inode.h"
 #include "dir.h"
+#include "dcache.h"
 
 // Directories
 
@@ -11,69 +14,443 @@ int dir_namecmp(const char *s, const char *t)
     return strncmp(s, t, DIRSIZ);
 }
 
+// Hash of a name of at most DIRSIZ characters (FNV-1a).
+uint32_t dir_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < DIRSIZ && name[i] != '\0'; i++) {
+        hash ^= (uint8_t) name[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+// Number of entries of block bn of directory dp that lie within its size.
+static uint32_t dir_nslots(struct inode *dp, uint32_t bn)
+{
+    uint32_t n = (dp->size - bn * BSIZE) / sizeof(struct dirent);
+
+    return n < DPB ? n : DPB;
+}
+
+// The slot among the first n of a directory block holding name, or -1.
+static int dir_scan(struct buf *bp, uint32_t n, char *name)
+{
+    struct dirent *de = (struct dirent *) bp->data;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+        if (de[i].inum != 0 && dir_namecmp(de[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+// The first free slot among the first n of a directory block, or -1.
+static int dir_free(struct buf *bp, uint32_t n)
+{
+    struct dirent *de = (struct dirent *) bp->data;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+        if (de[i].inum == 0)
+            return i;
+    return -1;
+}
+
+// Add a zeroed block to the end of indexed directory dp, setting *bn to
+// its number, and return it locked.
+static struct buf *dir_grow(struct inode *dp, uint32_t *bn)
+{
+    *bn = dp->size / BSIZE;
+    dp->size += BSIZE;
+    inode_update(dp);
+    return inode_block(dp, *bn);
+}
+
+/**
+ * Index nodes: the root, from slot 2 of block 0, or an index block.
+ */
+struct dxnode {
+    struct dxhead *head;
+    struct dxentry *ent;
+    uint32_t limit;  // entries that fit
+};
+
+// Set up n as a new, empty node in bp from slot on.
+static void dx_init(struct dxnode *n, struct buf *bp, int slot)
+{
+    n->head = (struct dxhead *) bp->data + slot;
+    n->ent = (struct dxentry *) (n->head + 1);
+    n->limit = DPB - slot - 1;
+    memset(n->head, 0, (DPB - slot) * sizeof(struct dirent));
+    n->head->magic = DX_MAGIC;
+}
+
+// Set up n as the node in bp from slot on.
+static void dx_load(struct dxnode *n, struct buf *bp, int slot)
+{
+    n->head = (struct dxhead *) bp->data + slot;
+    n->ent = (struct dxentry *) (n->head + 1);
+    n->limit = DPB - slot - 1;
+    if (n->head->magic != DX_MAGIC || n->head->count < 1
+        || n->head->count > n->limit || n->head->levels > 1)
+        KERN_PANIC("dir: bad index in block %d", bp->sector);
+}
+
+// Whether directory dp, whose block 0 is bp, is indexed.
+static bool dx_indexed(struct inode *dp, struct buf *bp)
+{
+    struct dxhead *head = (struct dxhead *) bp->data + 2;
+
+    return dp->size >= 2 * BSIZE && head->inum == 0
+        && head->magic == DX_MAGIC;
+}
+
+// The entry of node n covering hash, by binary search.
+static uint32_t dx_find(struct dxnode *n, uint32_t hash)
+{
+    uint32_t lo = 0, hi = n->head->count - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (n->ent[mid].hash <= hash)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+// The block entry i of node n of directory dp refers to.
+static uint32_t dx_block(struct inode *dp, struct dxnode *n, uint32_t i)
+{
+    uint32_t bn = n->ent[i].block;
+
+    if (bn == 0 || bn >= dp->size / BSIZE)
+        KERN_PANIC("dir: index refers to block %d", bn);
+    return bn;
+}
+
+// Insert (hash, bn) as entry i of node n, which has room for it.
+static void dx_add(struct dxnode *n, uint32_t i, uint32_t hash, uint32_t bn)
+{
+    memmove(&n->ent[i + 1], &n->ent[i],
+            (n->head->count - i) * sizeof(struct dxentry));
+    memset(&n->ent[i], 0, sizeof(struct dxentry));
+    n->ent[i].hash = hash;
+    n->ent[i].block = bn;
+    n->head->count++;
+}
+
+// The leaf block of indexed directory dp, whose block 0 is rb, that may
+// hold names with hash.
+static uint32_t dx_leaf(struct inode *dp, struct buf *rb, uint32_t hash)
+{
+    struct dxnode n;
+    struct buf *bp;
+    uint32_t bn;
+
+    dx_load(&n, rb, 2);
+    bn = dx_block(dp, &n, dx_find(&n, hash));
+    if (n.head->levels > 0) {
+        bp = inode_block(dp, bn);
+        dx_load(&n, bp, 0);
+        bn = dx_block(dp, &n, dx_find(&n, hash));
+        bufcache_release(bp);
+    }
+    return bn;
+}
+
+/**
+ * Index directory dp, whose only block is full: its entries but "." and
+ * ".." move to a new leaf, and the rest of block 0 becomes the root.
+ * Returns -1 if block 0 does not start with "." and "..".
+ */
+static int dx_create(struct inode *dp)
+{
+    struct buf *rb, *lb;
+    struct dirent *de;
+    struct dxnode root;
+    uint32_t bn;
+
+    rb = inode_block(dp, 0);
+    de = (struct dirent *) rb->data;
+    if (de[0].inum == 0 || dir_namecmp(de[0].name, ".") != 0
+        || de[1].inum == 0 || dir_namecmp(de[1].name, "..") != 0) {
+        bufcache_release(rb);
+        return -1;
+    }
+
+    lb = dir_grow(dp, &bn);
+    memmove(lb->data, &de[2], (DPB - 2) * sizeof(*de));
+    log_write(lb);
+    bufcache_release(lb);
+
+    dx_init(&root, rb, 2);
+    root.ent[0].block = bn;
+    root.head->count = 1;
+    log_write(rb);
+    bufcache_release(rb);
+    return 0;
+}
+
+/**
+ * The hash splitting full leaf bp in two: the entries hashing to it or
+ * more move to a new leaf, the others stay. 0 if all have the same hash.
+ */
+static uint32_t dx_split_hash(struct buf *bp)
+{
+    struct dirent *de = (struct dirent *) bp->data;
+    uint32_t hash[DPB], h;
+    int i, j;
+
+    // Insertion sort of the hashes.
+    for (i = 0; i < DPB; i++) {
+        h = dir_hash(de[i].name);
+        for (j = i; j > 0 && hash[j - 1] > h; j--)
+            hash[j] = hash[j - 1];
+        hash[j] = h;
+    }
+    for (i = DPB / 2; i < DPB; i++)
+        if (hash[i] > hash[0])
+            return hash[i];
+    return 0;
+}
+
+// Write a new entry (name, inum) into indexed directory dp, whose block 0
+// is rb. Releases rb.
+static int dx_link(struct inode *dp, struct buf *rb, char *name,
+                   uint32_t inum)
+{
+    struct dxnode root, mid, next, *parent;
+    struct buf *mb, *lb, *bp;
+    struct dirent *de;
+    uint32_t hash, pos, i, n, half, bn, split;
+    int slot, r;
+
+    hash = dir_hash(name);
+    mb = 0;
+    r = -1;
+
+    // "." and ".." stay in block 0, before the root.
+    if (dir_scan(rb, 2, name) >= 0) {
+        bufcache_release(rb);
+        return -1;
+    }
+    dx_load(&root, rb, 2);
+    pos = dx_find(&root, hash);
+    parent = &root;
+    if (root.head->levels > 0) {
+        mb = inode_block(dp, dx_block(dp, &root, pos));
+        dx_load(&mid, mb, 0);
+        parent = &mid;
+    }
+    i = dx_find(parent, hash);
+    lb = inode_block(dp, dx_block(dp, parent, i));
+    if (dir_scan(lb, DPB, name) >= 0)
+        goto out;
+
+    if ((slot = dir_free(lb, DPB)) < 0) {
+        // The leaf is full. Make room in its parent for another.
+        if ((split = dx_split_hash(lb)) == 0)
+            goto out;
+        if (parent->head->count == parent->limit) {
+            if (mb == 0) {
+                // Move the root down into an index block of its own.
+                mb = dir_grow(dp, &bn);
+                dx_init(&mid, mb, 0);
+                memmove(mid.ent, root.ent,
+                        root.head->count * sizeof(struct dxentry));
+                mid.head->count = root.head->count;
+                memset(root.ent, 0, root.limit * sizeof(struct dxentry));
+                root.ent[0].block = bn;
+                root.head->count = 1;
+                root.head->levels = 1;
+                pos = 0;
+            } else if (root.head->count == root.limit) {
+                goto out;  // The directory is full.
+            } else {
+                // Split the index block, the upper half going to a new one.
+                bp = dir_grow(dp, &bn);
+                dx_init(&next, bp, 0);
+                half = mid.head->count / 2;
+                memmove(next.ent, &mid.ent[half],
+                        (mid.head->count - half) * sizeof(struct dxentry));
+                next.head->count = mid.head->count - half;
+                memset(&mid.ent[half], 0,
+                       (mid.head->count - half) * sizeof(struct dxentry));
+                mid.head->count = half;
+                dx_add(&root, pos + 1, next.ent[0].hash, bn);
+                log_write(mb);
+                if (i >= half) {
+                    bufcache_release(mb);
+                    mb = bp;
+                    mid = next;
+                    i -= half;
+                } else {
+                    log_write(bp);
+                    bufcache_release(bp);
+                }
+            }
+            parent = &mid;
+            log_write(rb);
+            log_write(mb);
+        }
+
+        // Split the leaf.
+        bp = dir_grow(dp, &bn);
+        de = (struct dirent *) lb->data;
+        for (slot = 0, n = 0; slot < DPB; slot++) {
+            if (dir_hash(de[slot].name) >= split) {
+                memmove((struct dirent *) bp->data + n++, &de[slot],
+                        sizeof(*de));
+                memset(&de[slot], 0, sizeof(*de));
+            }
+        }
+        dx_add(parent, i + 1, split, bn);
+        log_write(parent == &root ? rb : mb);
+        log_write(lb);
+        log_write(bp);
+        if (hash >= split) {
+            bufcache_release(lb);
+            lb = bp;
+        } else {
+            bufcache_release(bp);
+        }
+        slot = dir_free(lb, DPB);
+    }
+
+    de = (struct dirent *) lb->data + slot;
+    de->inum = inum;
+    strncpy(de->name, name, DIRSIZ);
+    log_write(lb);
+    r = 0;
+
+  out:
+    bufcache_release(lb);
+    if (mb != 0)
+        bufcache_release(mb);
+    bufcache_release(rb);
+    return r;
+}
+
 /**
  * Look for a directory entry in a directory.
  * If found, set *poff to byte offset of entry.
  */
 struct inode *dir_lookup(struct inode *dp, char *name, uint32_t * poff)
 {
-    uint32_t off, inum;
-    struct dirent de;
+    struct buf *bp;
+    uint32_t bn, nb, inum;
+    int slot;
 
     if (dp->type != T_DIR)
-      KERN_PANIC("dir_lookup not DIR");
-
-    //TODO
-    uint32_t size = sizeof(de);
-    for(off = 0; off < dp->size; off += size)
-    {
-      if(inode_read(dp, (char*)&de, off, size) != size)        
-          KERN_PANIC("read size mismatch, dir_lookup");   
-      if(de.inum == 0)
-          continue;
-      
-      if(dir_namecmp(de.name, name) == 0){
-          if(poff != 0)
-            *poff = off;
-          
-          inum = de.inum;
-          return inode_get(dp->dev, inum);
-      }
+        KERN_PANIC("dir_lookup not DIR");
+
+    nb = (dp->size + BSIZE - 1) / BSIZE;
+    if (nb == 0) {
+        dcache_enter(dp->dev, dp->inum, name, 0);
+        return 0;
     }
-    return 0;
+
+    // An indexed directory has "." and ".." in block 0 and the name in
+    // one leaf. Otherwise every block is searched.
+    bn = 0;
+    bp = inode_block(dp, 0);
+    if (dx_indexed(dp, bp)) {
+        if ((slot = dir_scan(bp, 2, name)) < 0) {
+            bn = dx_leaf(dp, bp, dir_hash(name));
+            bufcache_release(bp);
+            bp = inode_block(dp, bn);
+            slot = dir_scan(bp, DPB, name);
+        }
+    } else {
+        while ((slot = dir_scan(bp, dir_nslots(dp, bn), name)) < 0
+               && ++bn < nb) {
+            bufcache_release(bp);
+            bp = inode_block(dp, bn);
+        }
+    }
+
+    if (slot < 0) {
+        bufcache_release(bp);
+        dcache_enter(dp->dev, dp->inum, name, 0);
+        return 0;
+    }
+    inum = ((struct dirent *) bp->data)[slot].inum;
+    bufcache_release(bp);
+    dcache_enter(dp->dev, dp->inum, name, inum);
+    if (poff != 0)
+        *poff = bn * BSIZE + slot * sizeof(struct dirent);
+    return inode_get(dp->dev, inum);
 }
 
-// Write a new directory entry (name, inum) into the directory dp.
-int dir_link(struct inode *dp, char *name, uint32_t inum)
+// Write a new entry (name, inum) into unindexed directory dp.
+static int dir_link_linear(struct inode *dp, char *name, uint32_t inum)
 {
     struct dirent de;
-    struct inode* node;
+    struct buf *bp;
+    uint32_t bn, nb, off;
+    int slot;
 
-    uint32_t poff;
-    uint32_t off;
-
-    // TODO: Check that name is not present.
-    uint32_t size = sizeof(de);
-    node = dir_lookup(dp, name, &poff);
-
-    if(node != 0 ){
-      inode_put(node);
-      return -1;
-    }
-    // TODO: Look for an empty dirent.
-    for(off = 0; off < dp->size; off += size)
-    {
-      if(inode_read(dp, (char*)&de, off, size) != size)
-        KERN_PANIC("read size mismatch, dir_link");
-      if(de.inum == 0)
-        break;
+    // Check that name is not present, and look for an empty dirent.
+    off = dp->size;
+    nb = (dp->size + BSIZE - 1) / BSIZE;
+    for (bn = 0; bn < nb; bn++) {
+        bp = inode_block(dp, bn);
+        if (dir_scan(bp, dir_nslots(dp, bn), name) >= 0) {
+            bufcache_release(bp);
+            return -1;
+        }
+        if (off == dp->size
+            && (slot = dir_free(bp, dir_nslots(dp, bn))) >= 0)
+            off = bn * BSIZE + slot * sizeof(de);
+        bufcache_release(bp);
     }
 
+    // A full directory of one block is indexed rather than extended.
+    if (off == BSIZE && dp->size == BSIZE && dx_create(dp) == 0)
+        return dx_link(dp, inode_block(dp, 0), name, inum);
+
+    memset(&de, 0, sizeof(de));
     de.inum = inum;
     strncpy(de.name, name, DIRSIZ);
-    if(inode_write(dp, (char*)&de, off, size) != size){
-      KERN_PANIC("write size mismatch, dir_link");
+    if (inode_write(dp, (char *) &de, off, sizeof(de)) != sizeof(de))
+        KERN_PANIC("write size mismatch, dir_link");
+    return 0;
+}
+
+// Write a new directory entry (name, inum) into the directory dp.
+int dir_link(struct inode *dp, char *name, uint32_t inum)
+{
+    struct buf *rb = 0;
+    int r;
+
+    if (dp->size >= 2 * BSIZE) {
+        rb = inode_block(dp, 0);
+        if (!dx_indexed(dp, rb)) {
+            bufcache_release(rb);
+            rb = 0;
+        }
     }
+    if (rb != 0)
+        r = dx_link(dp, rb, name, inum);
+    else
+        r = dir_link_linear(dp, name, inum);
+    if (r == 0)
+        dcache_enter(dp->dev, dp->inum, name, inum);
+    return r;
+}
 
-    return 0;
+// Remove the entry for name, at byte offset off, from the directory dp.
+void dir_unlink(struct inode *dp, char *name, uint32_t off)
+{
+    struct dirent de;
+
+    memset(&de, 0, sizeof(de));
+    if (inode_write(dp, (char *) &de, off, sizeof(de)) != sizeof(de))
+        KERN_PANIC("write size mismatch, dir_unlink");
+    dcache_enter(dp->dev, dp->inum, name, 0);
 }
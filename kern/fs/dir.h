@@ -11,19 +11,74 @@ struct dirent {
     char name[DIRSIZ];
 };
 
+// Directory entries per block.
+#define DPB (BSIZE / sizeof(struct dirent))
+
+/**
+ * Indexed directories.
+ *
+ * A directory whose first block fills up is indexed as it grows a second:
+ * block 0 keeps "." and "..", followed by the root of an index that maps
+ * hashes of names to leaf blocks of ordinary entries. With levels set,
+ * the root maps hashes to index blocks, which map them to leaves.
+ *
+ * Index slots are the size of a dirent and have an inode number of zero,
+ * so code reading the directory as a sequence of dirents sees every entry
+ * and takes the index for free slots. Directories that grew past one
+ * block unindexed are left as they are and searched linearly.
+ */
+#define DX_MAGIC 0x58444e49  // "INDX"
+
+// First slot of an index: at slot 2 of block 0, or 0 of an index block.
+struct dxhead {
+    uint16_t inum;    // always 0
+    uint16_t count;   // entries in use after the head
+    uint32_t magic;   // DX_MAGIC
+    uint16_t levels;  // root only: levels of index blocks below it
+    uint16_t pad[3];
+};
+
+// Names hashing to hash or more, up to the next entry, are in block.
+struct dxentry {
+    uint16_t inum;    // always 0
+    uint16_t pad;
+    uint32_t hash;    // 0 for the first entry
+    uint32_t block;   // block number within the directory
+    uint32_t pad2;
+};
+
 int dir_namecmp(const char *s, const char *t);
 
+// Hash of a name of at most DIRSIZ characters.
+uint32_t dir_hash(const char *name);
+
 /**
  * Look for a directory entry in a directory.
  * If found, set *poff to byte offset of entry.
  */
 struct inode *dir_lookup(struct inode *dp, char *name, uint32_t *poff);
 
+/**
+ * Most distinct sectors dir_link writes, when an indexed directory splits
+ * an index block and a leaf: block 0, two index blocks and two leaves,
+ * the directory's inode, the bitmap blocks of the two blocks it adds (at
+ * most two, as they are allocated next to each other) and up to four
+ * blocks of addresses mapping them. An indexed directory holds fewer than
+ * NDIRECT + NINDIRECT * NINDIRECT blocks, so two levels of addresses.
+ */
+#define DIRLINK_BLOCKS (5 + 1 + 2 + 4)
+
 /**
  * Write a new directory entry (name, inum) into the directory dp.
  */
 int dir_link(struct inode *dp, char *name, uint32_t inum);
 
+/**
+ * Remove the entry for name, found by dir_lookup at byte offset off,
+ * from the directory dp.
+ */
+void dir_unlink(struct inode *dp, char *name, uint32_t off);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_FS_DIR_H_ */
@@ -3,6 +3,7 @@
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
 #include <kern/lib/spinlock.h>
+#include <thread/PThread/export.h>
 #include "params.h"
 #include "stat.h"
 #include "dinode.h"
@@ -17,7 +18,11 @@ struct {
 
 void file_init(void)
 {
+    int i;
+
     spinlock_init(&ftable.lock);
+    for (i = 0; i < NFILE; i++)
+        mutex_init(&ftable.file[i].lock);
 }
 
 /**
@@ -92,6 +97,26 @@ int file_stat(struct file *f, struct file_stat *st)
     return -1;
 }
 
+/**
+ * Lock file f for one read or write, so that the offset moves consistently
+ * when several processes share it. A sleeping lock, since the holder waits
+ * for the disk; independent files never contend.
+ */
+void file_lock(struct file *f)
+{
+    mutex_lock(&f->lock);
+}
+
+/**
+ * Unlock file f.
+ */
+void file_unlock(struct file *f)
+{
+    if (!mutex_holding(&f->lock))
+        KERN_PANIC("file_unlock");
+    mutex_unlock(&f->lock);
+}
+
 /**
  * Read from file f.
  */
@@ -122,25 +147,26 @@ int file_write(struct file *f, char *addr, int n)
     if (f->writable == 0)
         return -1;
     if (f->type == FD_INODE) {
-        // Write a few blocks at a time to avoid exceeding
-        // the maximum log transaction size, including
-        // i-node, indirect block, allocation blocks,
-        // and 2 blocks of slop for non-aligned writes.
+        // Write as many blocks at a time as a log transaction
+        // can hold, including i-node, blocks of addresses, allocation
+        // blocks, and slop for non-aligned writes (log_write_sectors),
+        // and reserve just the room each chunk needs.
         // this really belongs lower down, since inode_write()
         // might be writing a device like the console.
-        int max = ((LOGSIZE - 1 - 1 - 2) / 2) * 512;
+        int max = log_max_write();
         int i = 0;
         while (i < n) {
             int n1 = n - i;
             if (n1 > max)
                 n1 = max;
+            int nsectors = log_write_sectors(n1);
 
-            begin_trans();
+            begin_trans_n(nsectors);
             inode_lock(f->ip);
             if ((r = inode_write(f->ip, addr + i, f->off, n1)) > 0)
                 f->off += r;
             inode_unlock(f->ip);
-            commit_trans();
+            commit_trans_n(nsectors);
 
             if (r < 0)
                 break;
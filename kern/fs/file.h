@@ -12,6 +12,7 @@
 
 #ifdef _KERN_
 
+#include <kern/lib/mutex.h>
 #include "stat.h"
 #include "inode.h"
 
@@ -20,6 +21,7 @@ struct file {
     int ref;  // reference count
     int8_t readable;
     int8_t writable;
+    mutex_t lock;  // held by file_lock
     struct inode *ip;
     uint32_t off;
 };
@@ -38,10 +40,16 @@ void file_close(struct file *f);
 // Get metadata about file f.
 int file_stat(struct file *f, struct file_stat *st);
 
-// Read from file f.
+// Lock file f, sleeping while another process holds it.
+void file_lock(struct file *f);
+
+// Unlock file f.
+void file_unlock(struct file *f);
+
+// Read from file f. Caller must hold f's lock.
 int file_read(struct file *f, char *addr, int n);
 
-// Write to file f.
+// Write to file f. Caller must hold f's lock.
 int file_write(struct file *f, char *addr, int n);
 
 #define CONSOLE 1
@@ -6,55 +6,188 @@
 #include <kern/lib/debug.h>
 #include <kern/lib/string.h>
 #include <kern/lib/spinlock.h>
+#include <kern/lib/rwlock.h>
+#include <kern/lib/x86.h>
 #include <thread/PThread/export.h>
 #include "bufcache.h"
 #include "log.h"
 #include "block.h"
 #include "inode.h"
+#include "dcache.h"
 
 struct devsw *devsw;
 
 static void inode_trunc(struct inode *ip);
 
+/**
+ * lock serializes freeing an unlinked inode in inode_put with its lookups.
+ * map_lk protects which (dev, inum) each entry caches: lookups of cached
+ * inodes only read it, recycling an entry writes it. ref is updated with
+ * atomic adds since lookups bump it under the read side of map_lk alone.
+ */
 struct {
     spinlock_t lock;
+    rwlock_t map_lk;
     struct inode inode[NINODE];
 } inode_cache;
 
 void inode_init(void)
 {
+    int i;
+
     spinlock_init(&inode_cache.lock);
+    rwlock_init(&inode_cache.map_lk);
+    for (i = 0; i < NINODE; i++)
+        mutex_init(&inode_cache.inode[i].lock);
 }
 
 struct inode *inode_get(uint32_t dev, uint32_t inum);
 
+// Inodes a file is allocated among, from the first of its directory's
+// inode block, before falling back on the cursor.
+#define IMAP_NEAR (4 * IPB)
+
 /**
- * Allocate a new inode with the given type on device dev.
- * A free inode has a type of zero.
+ * Which inodes of each device are in use, read from the inode table when
+ * the device is mounted so that allocation does not scan it. A set bit is
+ * an inode in use. Directories are spread through the table from a
+ * rotating cursor; files go near their directory.
  */
-struct inode *inode_alloc(uint32_t dev, short type)
+struct imap {
+    spinlock_t lock;
+    bool ready;
+    uint32_t ninodes;
+    uint32_t nfree;
+    uint32_t cursor;  // where the next directory search starts
+    uint32_t bits[NIMAP / 32];
+};
+static struct imap imap[NDEV];
+
+static struct imap *imap_get(uint32_t dev)
 {
-    int inum;
+    if (dev >= NDEV || !imap[dev].ready)
+        KERN_PANIC("imap: device %d not mounted", dev);
+    return &imap[dev];
+}
+
+/**
+ * Build the free inode summary of device dev, once its log is recovered.
+ */
+void inode_mount(uint32_t dev)
+{
+    struct imap *m;
     struct buf *bp;
     struct dinode *dip;
     struct superblock sb;
+    uint32_t inum;
 
+    if (dev >= NDEV)
+        KERN_PANIC("inode_mount: bad device %d", dev);
+    m = &imap[dev];
     read_superblock(dev, &sb);
-
+    if (sb.ninodes > NIMAP)
+        KERN_PANIC("inode_mount: %d inodes, at most %d", sb.ninodes, NIMAP);
+
+    spinlock_init(&m->lock);
+    memset(m->bits, 0, sizeof(m->bits));
+    m->ninodes = sb.ninodes;
+    m->nfree = 0;
+    m->bits[0] = 1;  // inode 0 is never used
+    bp = 0;
     for (inum = 1; inum < sb.ninodes; inum++) {
-        bp = bufcache_read(dev, IBLOCK(inum));
-        dip = (struct dinode *) bp->data + inum % IPB;
-        if (dip->type == 0) {  // a free inode
-            memset(dip, 0, sizeof(*dip));
-            dip->type = type;
-            log_write(bp);  // mark it allocated on the disk
-            bufcache_release(bp);
-            return inode_get(dev, inum);
+        if (bp == 0 || inum % IPB == 0) {
+            if (bp != 0)
+                bufcache_release(bp);
+            bp = bufcache_read_meta(dev, IBLOCK(inum));
         }
+        dip = (struct dinode *) bp->data + inum % IPB;
+        if (dip->type != 0)
+            m->bits[inum / 32] |= 1 << (inum % 32);
+        else
+            m->nfree++;
+    }
+    if (bp != 0)
         bufcache_release(bp);
+    m->cursor = 1;
+    m->ready = TRUE;
+}
+
+/**
+ * Find a free inode among the n from start on, wrapping around the end of
+ * the table, and mark it in use. Returns 0 if there is none.
+ * Called with m->lock held.
+ */
+static uint32_t imap_claim(struct imap *m, uint32_t start, uint32_t n)
+{
+    uint32_t inum;
+
+    if (start == 0 || start >= m->ninodes)
+        start = 1;
+    for (inum = start; n > 0; n--, inum++) {
+        if (inum >= m->ninodes)
+            inum = 0;
+        if (inum % 32 == 0 && m->bits[inum / 32] == 0xffffffff && n >= 32) {
+            inum += 31;
+            n -= 31;
+            continue;
+        }
+        if ((m->bits[inum / 32] & (1 << (inum % 32))) == 0) {
+            m->bits[inum / 32] |= 1 << (inum % 32);
+            m->nfree--;
+            return inum;
+        }
     }
-    KERN_PANIC("inode_alloc: no inodes");
-    return NULL;
+    return 0;
+}
+
+/**
+ * Allocate a new inode with the given type on device dev, near inode
+ * near if it is a file. A free inode has a type of zero.
+ */
+struct inode *inode_alloc(uint32_t dev, short type, uint32_t near)
+{
+    struct imap *m = imap_get(dev);
+    uint32_t inum = 0;
+    struct buf *bp;
+    struct dinode *dip;
+
+    spinlock_acquire(&m->lock);
+    if (m->nfree > 0) {
+        if (type != T_DIR && near != 0)
+            inum = imap_claim(m, near - near % IPB, IMAP_NEAR);
+        if (inum == 0) {
+            inum = imap_claim(m, m->cursor, m->ninodes);
+            m->cursor = inum + 1;
+        }
+    }
+    spinlock_release(&m->lock);
+    if (inum == 0)
+        KERN_PANIC("inode_alloc: no inodes");
+
+    bp = bufcache_read_meta(dev, IBLOCK(inum));
+    dip = (struct dinode *) bp->data + inum % IPB;
+    if (dip->type != 0)
+        KERN_PANIC("inode_alloc: inode %d is in use", inum);
+    memset(dip, 0, sizeof(*dip));
+    dip->type = type;
+    log_write(bp);  // mark it allocated on the disk
+    bufcache_release(bp);
+    return inode_get(dev, inum);
+}
+
+/**
+ * Return inode inum of device dev, just freed on disk, to the summary.
+ */
+static void imap_free(uint32_t dev, uint32_t inum)
+{
+    struct imap *m = imap_get(dev);
+
+    spinlock_acquire(&m->lock);
+    if ((m->bits[inum / 32] & (1 << (inum % 32))) == 0)
+        KERN_PANIC("imap_free: inode %d is free", inum);
+    m->bits[inum / 32] &= ~(1 << (inum % 32));
+    m->nfree++;
+    spinlock_release(&m->lock);
 }
 
 /**
@@ -65,7 +198,7 @@ void inode_update(struct inode *ip)
     struct buf *bp;
     struct dinode *dip;
 
-    bp = bufcache_read(ip->dev, IBLOCK(ip->inum));
+    bp = bufcache_read_meta(ip->dev, IBLOCK(ip->inum));
     dip = (struct dinode *) bp->data + ip->inum % IPB;
     dip->type = ip->type;
     dip->major = ip->major;
@@ -86,14 +219,24 @@ struct inode *inode_get(uint32_t dev, uint32_t inum)
 {
     struct inode *ip, *empty;
 
-    spinlock_acquire(&inode_cache.lock);
-
     // Is the inode already cached?
+    rwlock_read_acquire(&inode_cache.map_lk);
+    for (ip = &inode_cache.inode[0]; ip < &inode_cache.inode[NINODE]; ip++) {
+        if (ip->ref > 0 && ip->dev == dev && ip->inum == inum) {
+            xadd((volatile uint32_t *) &ip->ref, 1);
+            rwlock_read_release(&inode_cache.map_lk);
+            return ip;
+        }
+    }
+    rwlock_read_release(&inode_cache.map_lk);
+
+    // Not cached; look again since it may have been added meanwhile.
+    rwlock_write_acquire(&inode_cache.map_lk);
     empty = 0;
     for (ip = &inode_cache.inode[0]; ip < &inode_cache.inode[NINODE]; ip++) {
         if (ip->ref > 0 && ip->dev == dev && ip->inum == inum) {
-            ip->ref++;
-            spinlock_release(&inode_cache.lock);
+            xadd((volatile uint32_t *) &ip->ref, 1);
+            rwlock_write_release(&inode_cache.map_lk);
             return ip;
         }
         if (empty == 0 && ip->ref == 0)  // Remember empty slot.
@@ -109,7 +252,9 @@ struct inode *inode_get(uint32_t dev, uint32_t inum)
     ip->inum = inum;
     ip->ref = 1;
     ip->flags = 0;
-    spinlock_release(&inode_cache.lock);
+    ip->mapkey = 0;
+    ip->lastblk = 0;
+    rwlock_write_release(&inode_cache.map_lk);
 
     return ip;
 }
@@ -120,9 +265,7 @@ struct inode *inode_get(uint32_t dev, uint32_t inum)
  */
 struct inode *inode_dup(struct inode *ip)
 {
-    spinlock_acquire(&inode_cache.lock);
-    ip->ref++;
-    spinlock_release(&inode_cache.lock);
+    xadd((volatile uint32_t *) &ip->ref, 1);
     return ip;
 }
 
@@ -138,14 +281,10 @@ void inode_lock(struct inode *ip)
     if (ip == 0 || ip->ref < 1)
         KERN_PANIC("inode_lock");
 
-    spinlock_acquire(&inode_cache.lock);
-    while (ip->flags & I_BUSY)
-        thread_sleep(ip, &inode_cache.lock);
-    ip->flags |= I_BUSY;
-    spinlock_release(&inode_cache.lock);
+    mutex_lock(&ip->lock);
 
     if (!(ip->flags & I_VALID)) {
-        bp = bufcache_read(ip->dev, IBLOCK(ip->inum));
+        bp = bufcache_read_meta(ip->dev, IBLOCK(ip->inum));
         dip = (struct dinode *) bp->data + ip->inum % IPB;
         ip->type = dip->type;
         ip->major = dip->major;
@@ -154,6 +293,8 @@ void inode_lock(struct inode *ip)
         ip->size = dip->size;
         memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
         bufcache_release(bp);
+        ip->mapkey = 0;
+        ip->lastblk = 0;
         ip->flags |= I_VALID;
         if (ip->type == 0)
             KERN_PANIC("inode_lock: no type");
@@ -166,13 +307,10 @@ void inode_lock(struct inode *ip)
  */
 void inode_unlock(struct inode *ip)
 {
-    if (ip == 0 || !(ip->flags & I_BUSY) || ip->ref < 1)
+    if (ip == 0 || !mutex_holding(&ip->lock) || ip->ref < 1)
         KERN_PANIC("inode_unlock");
 
-    spinlock_acquire(&inode_cache.lock);
-    ip->flags &= ~I_BUSY;
-    thread_wakeup(ip);
-    spinlock_release(&inode_cache.lock);
+    mutex_unlock(&ip->lock);
 }
 
 /**
@@ -187,18 +325,21 @@ void inode_put(struct inode *ip)
     spinlock_acquire(&inode_cache.lock);
     if (ip->ref == 1 && (ip->flags & I_VALID) && ip->nlink == 0) {
         // inode has no links: truncate and free inode.
-        if (ip->flags & I_BUSY)
+        if (!mutex_trylock(&ip->lock))
             KERN_PANIC("inode_put busy");
-        ip->flags |= I_BUSY;
         spinlock_release(&inode_cache.lock);
         inode_trunc(ip);
+        // Its number may come back as another directory.
+        if (ip->type == T_DIR)
+            dcache_purge(ip->dev, ip->inum);
         ip->type = 0;
         inode_update(ip);
+        imap_free(ip->dev, ip->inum);
         spinlock_acquire(&inode_cache.lock);
         ip->flags = 0;
-        thread_wakeup(ip);
+        mutex_unlock(&ip->lock);
     }
-    ip->ref--;
+    xadd((volatile uint32_t *) &ip->ref, -1);
     spinlock_release(&inode_cache.lock);
 }
 
@@ -217,8 +358,22 @@ void inode_unlockput(struct inode *ip)
  * The content (data) associated with each inode is stored
  * in blocks on the disk. The first NDIRECT block numbers
  * are listed in ip->addrs[]. The next NINDIRECT blocks are
- * listed in block ip->addrs[NDIRECT].
+ * listed in block ip->addrs[NDIRECT], the next NINDIRECT^2
+ * in the blocks listed in block ip->addrs[NDIRECT + 1], and
+ * the last NINDIRECT^3 one level further down from block
+ * ip->addrs[NDIRECT + 2].
+ */
+
+/**
+ * Allocate a block for inode ip, after the last one allocated to it if
+ * that is free, so that a file being extended stays contiguous on disk.
  */
+static uint32_t bmap_alloc(struct inode *ip, bool data)
+{
+    uint32_t goal = ip->lastblk ? ip->lastblk + 1 : 0;
+
+    return ip->lastblk = block_alloc(ip->dev, data, goal);
+}
 
 /**
  * Return the disk block address of the nth block in inode ip.
@@ -226,32 +381,76 @@ void inode_unlockput(struct inode *ip)
  */
 static uint32_t bmap(struct inode *ip, uint32_t bn)
 {
-    uint32_t addr, *a;
+    uint32_t addr, *a, key, span, idx;
     struct buf *bp;
+    int level;
 
     if (bn < NDIRECT) {
         if ((addr = ip->addrs[bn]) == 0)
-            ip->addrs[bn] = addr = block_alloc(ip->dev);
+            ip->addrs[bn] = addr = bmap_alloc(ip, ip->type != T_DIR);
         return addr;
     }
     bn -= NDIRECT;
 
-    if (bn < NINDIRECT) {
-        // Load indirect block, allocating if necessary.
-        if ((addr = ip->addrs[NDIRECT]) == 0)
-            ip->addrs[NDIRECT] = addr = block_alloc(ip->dev);
-        bp = bufcache_read(ip->dev, addr);
+    // Every block of addresses at the bottom level maps NINDIRECT
+    // consecutive blocks of the file; its copy in ip->map is keyed by
+    // their position, plus one.
+    key = bn / NINDIRECT + 1;
+    if (ip->mapkey == key && (addr = ip->map[bn % NINDIRECT]) != 0)
+        return addr;
+
+    // Find the level of indirection, and the number of blocks it maps.
+    for (level = 0, span = NINDIRECT; bn >= span; level++) {
+        if (level == NLEVELS - 1)
+            KERN_PANIC("bmap: out of range");
+        bn -= span;
+        span *= NINDIRECT;
+    }
+
+    // Walk down the blocks of addresses, allocating as necessary.
+    if ((addr = ip->addrs[NDIRECT + level]) == 0)
+        ip->addrs[NDIRECT + level] = addr = bmap_alloc(ip, FALSE);
+    do {
+        span /= NINDIRECT;
+        idx = bn / span;
+        bn %= span;
+        bp = bufcache_read_meta(ip->dev, addr);
         a = (uint32_t *) bp->data;
-        if ((addr = a[bn]) == 0) {
-            a[bn] = addr = block_alloc(ip->dev);
+        if ((addr = a[idx]) == 0) {
+            a[idx] = addr = bmap_alloc(ip, span == 1 && ip->type != T_DIR);
             log_write(bp);
         }
+        if (span == 1) {
+            memmove(ip->map, a, sizeof(ip->map));
+            ip->mapkey = key;
+        }
         bufcache_release(bp);
-        return addr;
-    }
+    } while (span > 1);
+    return addr;
+}
 
-    KERN_PANIC("bmap: out of range");
-    return 0;
+/**
+ * Free the blocks listed in block addr of device dev, which has [depth]
+ * levels of blocks of addresses below it, and the block itself.
+ */
+static void inode_trunc_map(uint32_t dev, uint32_t addr, int depth)
+{
+    struct buf *bp;
+    uint32_t *a;
+    int j;
+
+    bp = bufcache_read_meta(dev, addr);
+    a = (uint32_t *) bp->data;
+    for (j = 0; j < NINDIRECT; j++) {
+        if (a[j] == 0)
+            continue;
+        if (depth > 0)
+            inode_trunc_map(dev, a[j], depth - 1);
+        else
+            block_free(dev, a[j]);
+    }
+    bufcache_release(bp);
+    block_free(dev, addr);
 }
 
 /**
@@ -263,9 +462,7 @@ static uint32_t bmap(struct inode *ip, uint32_t bn)
  */
 static void inode_trunc(struct inode *ip)
 {
-    int i, j;
-    struct buf *bp;
-    uint32_t *a;
+    int i;
 
     for (i = 0; i < NDIRECT; i++) {
         if (ip->addrs[i]) {
@@ -274,18 +471,15 @@ static void inode_trunc(struct inode *ip)
         }
     }
 
-    if (ip->addrs[NDIRECT]) {
-        bp = bufcache_read(ip->dev, ip->addrs[NDIRECT]);
-        a = (uint32_t *) bp->data;
-        for (j = 0; j < NINDIRECT; j++) {
-            if (a[j])
-                block_free(ip->dev, a[j]);
+    for (i = 0; i < NLEVELS; i++) {
+        if (ip->addrs[NDIRECT + i]) {
+            inode_trunc_map(ip->dev, ip->addrs[NDIRECT + i], i);
+            ip->addrs[NDIRECT + i] = 0;
         }
-        bufcache_release(bp);
-        block_free(ip->dev, ip->addrs[NDIRECT]);
-        ip->addrs[NDIRECT] = 0;
     }
 
+    ip->mapkey = 0;
+    ip->lastblk = 0;
     ip->size = 0;
     inode_update(ip);
 }
@@ -302,6 +496,15 @@ void inode_stat(struct inode *ip, struct file_stat *st)
     st->size = ip->size;
 }
 
+/**
+ * Return block bn of inode ip locked in the cache as metadata, allocating
+ * it if there is none. The caller updates ip->size if it grows the file.
+ */
+struct buf *inode_block(struct inode *ip, uint32_t bn)
+{
+    return bufcache_read_meta(ip->dev, bmap(ip, bn));
+}
+
 /**
  * Read data from inode.
  */
@@ -322,7 +525,11 @@ int inode_read(struct inode *ip, char *dst, uint32_t off, uint32_t n)
         n = ip->size - off;
 
     for (tot = 0; tot < n; tot += m, off += m, dst += m) {
-        bp = bufcache_read(ip->dev, bmap(ip, off / BSIZE));
+        // Directory entries are metadata to the buffer cache.
+        if (ip->type == T_DIR)
+            bp = bufcache_read_meta(ip->dev, bmap(ip, off / BSIZE));
+        else
+            bp = bufcache_read(ip->dev, bmap(ip, off / BSIZE));
         m = min(n - tot, BSIZE - off % BSIZE);
         memmove(dst, bp->data + off % BSIZE, m);
         bufcache_release(bp);
@@ -353,7 +560,11 @@ int inode_write(struct inode *ip, char *src, uint32_t off, uint32_t n)
         bp = bufcache_read(ip->dev, bmap(ip, off / BSIZE));
         m = min(n - tot, BSIZE - off % BSIZE);
         memmove(bp->data + off % BSIZE, src, m);
-        log_write(bp);
+        // Directory entries are metadata to the log as well.
+        if (ip->type == T_DIR)
+            log_write(bp);
+        else
+            log_write_data(bp);
         bufcache_release(bp);
     }
 
@@ -38,9 +38,9 @@
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
-//   has first locked the inode. The I_BUSY flag indicates
-//   that the inode is locked. inode_lock() sets I_BUSY,
-//   while inode_unlock clears it.
+//   has first locked the inode. ip->lock is a sleeping
+//   mutex; inode_lock() takes it, while inode_unlock
+//   releases it.
 //
 // Thus a typical sequence is:
 //   ip = inode_get(dev, inum)
@@ -65,23 +65,34 @@
 
 #ifdef _KERN_
 
+#include <kern/lib/mutex.h>
 #include "params.h"
 #include "stat.h"
 #include "dinode.h"
 
+struct buf;
+
 // In-memory copy of an inode
 struct inode {
     uint32_t dev;   // Device number
     uint32_t inum;  // Inode number
     int ref;        // Reference count
-    int32_t flags;  // I_BUSY, I_VALID
+    int32_t flags;  // I_VALID
+    mutex_t lock;   // held while the inode is locked
 
     int16_t type;   // Copy of disk inode
     int16_t major;
     int16_t minor;
     int16_t nlink;
     uint32_t size;
-    uint32_t addrs[NDIRECT + 1];
+    uint32_t addrs[NDIRECT + NLEVELS];
+
+    // Copy of the last block of block addresses bmap used, so that
+    // sequential access reads it once rather than once per block.
+    uint32_t mapkey;              // which one, 0 if none
+    uint32_t map[NINDIRECT];
+
+    uint32_t lastblk;  // last block bmap allocated, 0 if none since loaded
 };
 
 // Table mapping major device number to device functions
@@ -94,9 +105,13 @@ extern struct devsw *devsw;
 
 void inode_init(void);
 
-// Allocate a new inode with the given type on device dev.
-// A free inode has a type of zero.
-struct inode *inode_alloc(uint32_t dev, short type);
+// Build the free inode summary of device dev. Called once its log is
+// recovered, before any allocation.
+void inode_mount(uint32_t dev);
+
+// Allocate a new inode with the given type on device dev, near inode
+// near if it is not a directory. A free inode has a type of zero.
+struct inode *inode_alloc(uint32_t dev, short type, uint32_t near);
 
 // Copy a modified in-memory inode to disk.
 void inode_update(struct inode *ip);
@@ -133,12 +148,21 @@ void inode_unlockput(struct inode *ip);
  * The content (data) associated with each inode is stored
  * in blocks on the disk. The first NDIRECT block numbers
  * are listed in ip->addrs[].  The next NINDIRECT blocks are
- * listed in block ip->addrs[NDIRECT].
+ * listed in block ip->addrs[NDIRECT], the next NINDIRECT^2
+ * in the blocks listed in block ip->addrs[NDIRECT + 1], and
+ * the last NINDIRECT^3 one level further down from block
+ * ip->addrs[NDIRECT + 2].
  */
 
 /** Copy stat information from inode. */
 void inode_stat(struct inode *ip, struct file_stat *st);
 
+/**
+ * Return block bn of the inode's content, locked in the cache, allocating
+ * it if needed. For directories, which are metadata; bufcache_release it.
+ */
+struct buf *inode_block(struct inode *ip, uint32_t bn);
+
 /** Read data from inode. */
 int inode_read(struct inode *ip, char *dst, uint32_t off, uint32_t n);
 
@@ -1,28 +1,50 @@
 // Simple logging. Each system call that might write the file system
 // should be surrounded with begin_trans() and commit_trans() calls.
 //
-// The log holds at most one transaction at a time. Commit forces
-// the log (with commit record) to disk, then installs the affected
-// blocks to disk, then erases the log. begin_trans() ensures that
-// only one system call can be in a transaction; others must wait.
+// Several system calls may join a transaction: begin_trans() admits a
+// call while the transaction has room for the sectors it may write,
+// MAXOPBLOCKS unless it asks for more with begin_trans_n(), beyond what
+// the calls already in it may write, and the last call to finish
+// commits the whole group. Calls that find the transaction full, or a
+// commit in progress, wait for the next group.
 //
-// Allowing only one transaction at a time means that the file
-// system code doesn't have to worry about the possibility of
-// one transaction reading a block that another one has modified,
-// for example an i-node block.
+// Committing the calls of a group together means that the file system
+// code doesn't have to worry about the possibility of one transaction
+// reading a block that another one has modified, for example an i-node
+// block: both reach the disk atomically or neither does.
 //
 // Read-only system calls don't need to use transactions, though
 // this means that they may observe uncommitted data. I-node and
 // buffer locks prevent read-only calls from seeing inconsistent data.
 //
-// The log is a physical re-do log containing disk blocks.
-// The on-disk log format:
-//   header block, containing sector #s for block A, B, C, ...
-//   block A
-//   block B
-//   block C
-//   ...
-// Log appends are synchronous.
+// The log is a physical re-do journal containing disk blocks, written
+// circularly. The on-disk log format:
+//   log superblock: sequence number and position of the oldest record
+//   record: descriptor block, containing the sequence number, sector #s
+//           for block A, B, C, ... and a checksum over all of them
+//           block A
+//           block B
+//           ...
+//   record: ...
+// log_write() only records and pins the modified buffers. Commit copies
+// them and their descriptor to the next free stretch of the journal and
+// waits for a single flush barrier: the checksum tells recovery whether
+// every sector of a record made it, so no ordering within it matters.
+// The committed blocks are then installed into the buffer cache, which
+// writes them home lazily. Only when the journal runs short of room does
+// begin_trans() checkpoint it, waiting for the installed blocks to reach
+// the disk and advancing the log superblock past their records.
+//
+// Recovery replays the records from the log superblock on, in sequence,
+// up to the first one whose sequence number or checksum does not match.
+//
+// In ordered mode, chosen when the log is mounted at boot, file data
+// skips the log: log_write_data() writes it in place, and commit waits
+// for it to reach the disk before writing the record of the metadata
+// that points to it. A data block is still logged if a replay could
+// write over it, that is if it was logged or freed since the last
+// checkpoint; that is when it last served as metadata or belonged to a
+// file whose removal may not be committed yet.
 
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
@@ -31,119 +53,461 @@
 #include <thread/PThread/export.h>
 #include "bufcache.h"
 #include "block.h"
+#include "inode.h"
+#include "log.h"
+
+#define LOG_MAGIC 0x4c4f4731  // "LOG1"
+
+// Hash slots tracking the sectors logged or freed since the last
+// checkpoint, for ordered mode. At most half of them are used.
+#define LOG_NTRACK 2048
 
-// Contents of the header block, used for both the on-disk header block
-// and to keep track in memory of logged sector #s before commit.
+// Sector #s a descriptor block has room for. The on-disk log size comes
+// from the superblock, but no transaction logs more sectors than this.
+#define LOG_MAXBLOCKS ((BSIZE - 4 * sizeof(uint32_t)) / sizeof(int))
+
+// Contents of the log superblock, the first sector of the log.
+struct logsuper {
+    uint32_t magic;
+    uint32_t seq;   // sequence number of the record at tail
+    uint32_t tail;  // journal offset of the oldest record to replay
+};
+
+// Contents of a descriptor block, used for both the on-disk record and to
+// keep track in memory of logged sector #s before commit.
 struct logheader {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t checksum;  // over the logged blocks and this header
     int n;
-    int sector[LOGSIZE];
+    int sector[LOG_MAXBLOCKS];
 };
 
+// lock protects the fields below but start, size and dev, which are set
+// once at boot, and head, used and seq, which only change while
+// committing is set.
 struct log {
     spinlock_t lock;
-    int start;
-    int size;
-    int busy;  // a transaction is active
+    int start;        // log superblock; the journal follows
+    int size;         // journal sectors
+    int capacity;     // sectors a transaction may log
+    int reserved;     // sectors reserved by the calls in the transaction
+    int outstanding;  // system calls in the open transaction
+    int committing;   // commit or checkpoint in progress; calls wait
+    uint32_t head;    // journal offset of the next record
+    uint32_t used;    // journal sectors holding records not checkpointed
+    uint32_t seq;     // sequence number of the next record
     int dev;
+    int ordered;      // file data is written in place, not logged
+    int ndata;        // data blocks written in place by the transaction
     struct logheader lh;
+    struct logstat stat;
+
+    // Sectors logged or freed since the last checkpoint, as sector + 1 in
+    // an open addressing hash table. Once half full, every sector counts.
+    uint32_t track[LOG_NTRACK];
+    uint32_t ntrack;
 };
 struct log log;
 
 static void recover_from_log(void);
+static void checkpoint_trans(void);
 
 void log_init(void)
 {
-    if (sizeof(struct logheader) >= BSIZE)
+    if (sizeof(struct logheader) > BSIZE)
         KERN_PANIC("log_init: too big logheader");
 
     struct superblock sb;
+    struct bufstat bs;
     spinlock_init(&log.lock);
+    log.reserved = 0;
+    log.outstanding = 0;
+    log.ndata = 0;
+#ifdef LOG_ORDERED
+    log.ordered = 1;
+#else
+    log.ordered = 0;
+#endif
+    log.committing = 0;
+    memset(&log.stat, 0, sizeof(log.stat));
     read_superblock(ROOTDEV, &sb);
     log.start = sb.size - sb.nlog;
-    log.size = sb.nlog;
+    log.size = sb.nlog - 1;
     log.dev = ROOTDEV;
+
+    // A record takes a descriptor besides its blocks. A log too small
+    // for several reservations admits one system call at a time.
+    log.capacity = log.size - 1;
+    if (log.capacity > LOG_MAXBLOCKS)
+        log.capacity = LOG_MAXBLOCKS;
+#ifdef LOG_CAPACITY
+    if (log.capacity > LOG_CAPACITY)
+        log.capacity = LOG_CAPACITY;
+#endif
+    // Every block of a group stays pinned in the cache until it commits;
+    // leave at least half of the cache to readers so that they never
+    // wait for a buffer that only the commit can free.
+    bufcache_get_stat(&bs);
+    if (log.capacity > bs.nbuf / 2)
+        log.capacity = bs.nbuf / 2;
+    if (log.capacity < 6)
+        KERN_PANIC("log_init: %d log blocks are too few", sb.nlog);
+    if (log_write_sectors(BSIZE) > log.capacity)
+        KERN_WARN("log_init: transactions of %d sectors may not hold "
+                  "a one-block write of %d\n", log.capacity,
+                  log_write_sectors(BSIZE));
+    KERN_INFO("[BSP KERN] Log: %d blocks, transactions of up to %d, %s.\n",
+              sb.nlog, log.capacity,
+              log.ordered ? "ordered data" : "journaled data");
     recover_from_log();
+    block_init(ROOTDEV);
+    inode_mount(ROOTDEV);
+}
+
+// Remember that a replay may write sector, or that it was freed.
+// Called with log.lock held.
+static void track_add(uint32_t sector)
+{
+    uint32_t i = sector % LOG_NTRACK;
+
+    if (log.ntrack >= LOG_NTRACK / 2)
+        return;
+    while (log.track[i] != 0 && log.track[i] != sector + 1)
+        i = (i + 1) % LOG_NTRACK;
+    if (log.track[i] == 0) {
+        log.track[i] = sector + 1;
+        log.ntrack++;
+    }
+}
+
+// Whether sector may have been logged or freed since the last
+// checkpoint. Called with log.lock held.
+static bool track_has(uint32_t sector)
+{
+    uint32_t i = sector % LOG_NTRACK;
+
+    if (log.ntrack >= LOG_NTRACK / 2)
+        return TRUE;
+    while (log.track[i] != 0) {
+        if (log.track[i] == sector + 1)
+            return TRUE;
+        i = (i + 1) % LOG_NTRACK;
+    }
+    return FALSE;
+}
+
+// Sector of journal offset off, which may run past the end and wrap.
+static uint32_t log_sector(uint32_t off)
+{
+    return log.start + 1 + off % log.size;
+}
+
+// 32-bit FNV-1a hash of data[0..len), continuing from sum.
+static uint32_t log_checksum(uint32_t sum, const void *data, int len)
+{
+    const uint8_t *p = data;
+
+    while (len-- > 0)
+        sum = (sum ^ *p++) * 16777619;
+    return sum;
+}
+
+// Checksum of the record described by lh, whose blocks are at the journal
+// offsets following head, to be stored in or checked against lh.
+static uint32_t record_checksum(struct logheader *lh, uint32_t head)
+{
+    struct logheader h = *lh;
+    uint32_t sum = 2166136261u;
+    int i;
+
+    for (i = 0; i < h.n; i++) {
+        struct buf *b = bufcache_read(log.dev, log_sector(head + 1 + i));
+        sum = log_checksum(sum, b->data, BSIZE);
+        bufcache_release(b);
+    }
+    h.checksum = 0;
+    return log_checksum(sum, &h, sizeof(h));
 }
 
-// Copy committed blocks from log to their home location.
-static void install_trans(void)
+// Install committed blocks at their home location. After a commit they
+// are still pinned in the cache, so only the pins log_write took are
+// dropped; when recovering at boot, they are copied from the record at
+// log.head.
+static void install_trans(int recovering)
 {
     int tail;
 
     for (tail = 0; tail < log.lh.n; tail++) {
-        struct buf *lbuf = bufcache_read(log.dev, log.start + tail + 1);  // read log block
         struct buf *dbuf = bufcache_read(log.dev, log.lh.sector[tail]);   // read dst
-        memmove(dbuf->data, lbuf->data, BSIZE);                           // copy block to dst
-        bufcache_write(dbuf);                                             // write dst to disk
-        bufcache_release(lbuf);
+        if (recovering) {
+            struct buf *lbuf = bufcache_read(log.dev, log_sector(log.head + 1 + tail));  // read log block
+            memmove(dbuf->data, lbuf->data, BSIZE);                                      // copy block to dst
+            bufcache_release(lbuf);
+        }
+        bufcache_write(dbuf);  // write dst back later
+        if (!recovering)
+            bufcache_unpin(dbuf);
         bufcache_release(dbuf);
     }
 }
 
-// Read the log header from disk into the in-memory log header.
-static void read_head(void)
+// Copy the modified blocks from the cache to a record at log.head, and
+// seal it with its descriptor. The journal blocks are overwritten whole,
+// so they are never read from the disk, and the next flush writes them
+// together as consecutive sectors.
+static void write_log(void)
 {
-    struct buf *buf = bufcache_read(log.dev, log.start);
-    struct logheader *lh = (struct logheader *) buf->data;
-    int i;
-    log.lh.n = lh->n;
-    for (i = 0; i < log.lh.n; i++) {
-        log.lh.sector[i] = lh->sector[i];
+    int tail;
+
+    for (tail = 0; tail < log.lh.n; tail++) {
+        struct buf *to = bufcache_overwrite(log.dev, log_sector(log.head + 1 + tail));  // log block
+        struct buf *from = bufcache_read(log.dev, log.lh.sector[tail]);                 // cached, pinned
+        memmove(to->data, from->data, BSIZE);
+        bufcache_write(to);
+        bufcache_release(from);
+        bufcache_release(to);
     }
+
+    log.lh.magic = LOG_MAGIC;
+    log.lh.seq = log.seq;
+    log.lh.checksum = record_checksum(&log.lh, log.head);
+
+    struct buf *buf = bufcache_overwrite(log.dev, log_sector(log.head));
+    memset(buf->data, 0, BSIZE);
+    memmove(buf->data, &log.lh, sizeof(log.lh));
+    bufcache_write(buf);
     bufcache_release(buf);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the current transaction commits.
-static void write_head(void)
+// Read the record at log.head into the in-memory log header. Returns 0
+// if there is no intact record with the expected sequence number there.
+// Records are checked against the limits of the format and the size of
+// the log, not log.capacity: a kernel built with a smaller LOG_CAPACITY
+// must still replay what another kernel committed.
+static int read_record(void)
 {
-    struct buf *buf = bufcache_read(log.dev, log.start);
-    struct logheader *hb = (struct logheader *) (buf->data);
-    int i;
-    hb->n = log.lh.n;
-    for (i = 0; i < log.lh.n; i++) {
-        hb->sector[i] = log.lh.sector[i];
-    }
+    struct buf *buf = bufcache_read(log.dev, log_sector(log.head));
+    memmove(&log.lh, buf->data, sizeof(log.lh));
+    bufcache_release(buf);
+
+    if (log.lh.magic != LOG_MAGIC || log.lh.seq != log.seq
+        || log.lh.n < 1 || log.lh.n > LOG_MAXBLOCKS
+        || log.used + log.lh.n + 1 > log.size)
+        return 0;
+    return record_checksum(&log.lh, log.head) == log.lh.checksum;
+}
+
+// Write the log superblock, pointing recovery at log.head.
+static void write_super(void)
+{
+    struct buf *buf = bufcache_overwrite(log.dev, log.start);
+    struct logsuper *ls = (struct logsuper *) buf->data;
+    memset(buf->data, 0, BSIZE);
+    ls->magic = LOG_MAGIC;
+    ls->seq = log.seq;
+    ls->tail = log.head;
     bufcache_write(buf);
     bufcache_release(buf);
 }
 
 static void recover_from_log(void)
 {
-    read_head();
-    install_trans();  // if committed, copy from log to disk
+    struct buf *buf = bufcache_read(log.dev, log.start);
+    struct logsuper ls = *(struct logsuper *) buf->data;
+    bufcache_release(buf);
+
+    log.used = 0;
+    if (ls.magic != LOG_MAGIC) {
+        // Fresh file system: start an empty journal.
+        log.head = 0;
+        log.seq = 1;
+        checkpoint_trans();
+        return;
+    }
+
+    log.head = ls.tail % log.size;
+    log.seq = ls.seq;
+    while (read_record()) {
+        install_trans(1);  // committed, copy from log to disk
+        log.head = (log.head + log.lh.n + 1) % log.size;
+        log.used += log.lh.n + 1;
+        log.seq++;
+    }
     log.lh.n = 0;
-    write_head();     // clear the log
+    checkpoint_trans();  // clear the log
 }
 
-void begin_trans(void)
+// Wait for the installed blocks to reach their home locations, then
+// advance the log superblock past their records. It must be on disk
+// before any record is written over them, or recovery would stop at the
+// overwritten record and miss the ones after it.
+static void checkpoint_trans(void)
 {
+    bufcache_flush();
+    write_super();
+    bufcache_flush();
+    log.used = 0;
+    memset(log.track, 0, sizeof(log.track));
+    log.ntrack = 0;
+}
+
+// Sectors reserved for a call that may write up to nsectors. A log
+// smaller than MAXOPBLOCKS holds one call at a time.
+static int log_reservation(int nsectors)
+{
+    return nsectors < log.capacity ? nsectors : log.capacity;
+}
+
+// Called at the start of each FS system call that may write up to
+// nsectors distinct sectors. Joins the open transaction once it has room
+// for them.
+void begin_trans_n(int nsectors)
+{
+    nsectors = log_reservation(nsectors);
+
     spinlock_acquire(&log.lock);
-    while (log.busy) {
-        thread_sleep(&log, &log.lock);
+    while (1) {
+        if (log.committing) {
+            thread_sleep(&log, &log.lock);
+        } else if (log.outstanding == 0
+                   && (log.size - log.used < log.capacity + 1
+                       || log.ntrack >= LOG_NTRACK / 2)) {
+            // First call of a new group, and the journal may not have
+            // room for its record, or ordered mode has lost track of
+            // what it holds: free the records checkpointed so far.
+            log.committing = 1;
+            spinlock_release(&log.lock);
+            checkpoint_trans();
+            spinlock_acquire(&log.lock);
+            log.stat.checkpoints++;
+            log.committing = 0;
+            thread_wakeup(&log);
+        } else if (log.lh.n + log.reserved + nsectors > log.capacity) {
+            // This group is full; wait for it to commit.
+            log.stat.waits++;
+            thread_sleep(&log, &log.lock);
+        } else {
+            log.reserved += nsectors;
+            log.outstanding++;
+            log.stat.ops++;
+            break;
+        }
     }
-    log.busy = 1;
     spinlock_release(&log.lock);
 }
 
-void commit_trans(void)
+void begin_trans(void)
+{
+    begin_trans_n(MAXOPBLOCKS);
+}
+
+// Distinct sectors a file_write() of n bytes may log: the data blocks,
+// one more for a write that is not aligned, and the i-node. For every
+// bottom-level block of addresses the blocks cross, bmap may log it and
+// the blocks above it, newly allocated or updated, NLEVELS + 1 at most.
+// Every block allocated may sit in a bitmap block of its own.
+int log_write_sectors(uint32_t n)
 {
-    if (log.lh.n > 0) {
-        write_head();     // Write header to disk -- the real commit
-        install_trans();  // Now install writes to home locations
+    int ndata, nmaps, nalloc;
+
+    ndata = (n + BSIZE - 1) / BSIZE + 1;
+    nmaps = (ndata + NINDIRECT - 1) / NINDIRECT + 1;
+    nalloc = ndata + nmaps * NLEVELS;
+    return ndata + 1 + nmaps * (NLEVELS + 1) + nalloc;
+}
+
+// Bytes a file_write() transaction may carry: the most whole blocks whose
+// log_write_sectors() fit in a transaction, but at least one block.
+uint32_t log_max_write(void)
+{
+    uint32_t n;
+
+    for (n = log.capacity * BSIZE; n > BSIZE; n -= BSIZE)
+        if (log_write_sectors(n) <= log.capacity)
+            break;
+    return n;
+}
+
+// Commit the group: write its record to the journal, then install its
+// blocks. Called with no locks held and committing set, so no system call
+// can join or log_write meanwhile. Returns the number of blocks logged.
+static int commit(void)
+{
+    int n = log.lh.n;
+
+    if (n > 0 && log.ndata > 0)
+        bufcache_flush();  // Ordered mode: data before the metadata
+    log.ndata = 0;
+    if (n > 0) {
+        write_log();       // Write the record to the journal
+        bufcache_flush();  // Once all of it is on disk, it is committed
+        install_trans(0);  // Now install writes to home locations
+        log.head = (log.head + n + 1) % log.size;
+        log.used += n + 1;
+        log.seq++;
         log.lh.n = 0;
-        write_head();     // Erase the transaction from the log
     }
+    return n;
+}
+
+// Called at the end of each FS system call, with the nsectors passed to
+// begin_trans_n(). The last call of the group commits it.
+void commit_trans_n(int nsectors)
+{
+    int do_commit = 0, n;
+
+    nsectors = log_reservation(nsectors);
 
     spinlock_acquire(&log.lock);
-    log.busy = 0;
-    thread_wakeup(&log);
+    if (log.outstanding < 1 || log.committing || log.reserved < nsectors)
+        KERN_PANIC("commit_trans");
+    // The sectors this call logged are counted in lh.n from now on.
+    log.reserved -= nsectors;
+    log.outstanding--;
+    if (log.outstanding == 0) {
+        do_commit = 1;
+        log.committing = 1;
+    } else {
+        // begin_trans() may be waiting for the room this call reserved.
+        thread_wakeup(&log);
+    }
+    spinlock_release(&log.lock);
+
+    if (do_commit) {
+        n = commit();
+        spinlock_acquire(&log.lock);
+        if (n > 0) {
+            log.stat.commits++;
+            log.stat.blocks += n;
+        }
+        log.committing = 0;
+        thread_wakeup(&log);
+        spinlock_release(&log.lock);
+    }
+}
+
+void commit_trans(void)
+{
+    commit_trans_n(MAXOPBLOCKS);
+}
+
+// Copy the transaction statistics to *stat, and clear them if reset.
+void log_get_stat(struct logstat *stat, bool reset)
+{
+    spinlock_acquire(&log.lock);
+    if (stat != NULL) {
+        *stat = log.stat;
+        stat->capacity = log.capacity;
+    }
+    if (reset)
+        memset(&log.stat, 0, sizeof(log.stat));
     spinlock_release(&log.lock);
 }
 
 // Caller has modified b->data and is done with the buffer.
-// Append the block to the log and record the block number,
-// but don't write the log header (which would commit the write).
+// Record the block number and pin the buffer in the cache; commit
+// copies it to the log. No disk I/O happens here.
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bufcache_read(...)
 //   modify bp->data[]
@@ -153,22 +517,61 @@ void log_write(struct buf *b)
 {
     int i;
 
-    if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
-        KERN_PANIC("too big a transaction. %d < %d <= %d",
-                   log.size, log.lh.n, LOGSIZE);
-    if (!log.busy)
+    spinlock_acquire(&log.lock);
+    if (log.outstanding < 1)
         KERN_PANIC("write outside of trans");
 
     for (i = 0; i < log.lh.n; i++) {
         if (log.lh.sector[i] == b->sector)  // log absorbtion?
             break;
     }
-    log.lh.sector[i] = b->sector;
-    struct buf *lbuf = bufcache_read(b->dev, log.start + i + 1);
-    memmove(lbuf->data, b->data, BSIZE);
-    bufcache_write(lbuf);
-    bufcache_release(lbuf);
-    if (i == log.lh.n)
+    if (i == log.lh.n) {
+        if (log.lh.n >= log.capacity)
+            KERN_PANIC("too big a transaction. %d < %d <= %d",
+                       log.capacity, log.lh.n, LOG_MAXBLOCKS);
+        log.lh.sector[i] = b->sector;
         log.lh.n++;
-    b->flags |= B_DIRTY;  // XXX: prevent eviction
+        bufcache_pin(b);  // keep it in memory and off the disk until installed
+        if (log.ordered)
+            track_add(b->sector);
+    }
+    spinlock_release(&log.lock);
+}
+
+// Like log_write(), for a block of file data. In ordered mode it is
+// written in place, before the transaction commits, unless a replay
+// could write over it.
+void log_write_data(struct buf *b)
+{
+    bool logged;
+
+    if (!log.ordered) {
+        log_write(b);
+        return;
+    }
+
+    spinlock_acquire(&log.lock);
+    if (log.outstanding < 1)
+        KERN_PANIC("write outside of trans");
+    logged = track_has(b->sector);
+    if (!logged)
+        log.ndata++;
+    spinlock_release(&log.lock);
+
+    if (logged)
+        log_write(b);
+    else
+        bufcache_write(b);
+}
+
+// Block b of device dev has been freed by the open transaction. In
+// ordered mode, it must not be written in place before a checkpoint: if
+// the transaction does not commit, the file it belonged to keeps it.
+void log_free(uint32_t dev, uint32_t b)
+{
+    if (!log.ordered)
+        return;
+    spinlock_acquire(&log.lock);
+    track_add(b);
+    spinlock_release(&log.lock);
 }
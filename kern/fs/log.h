@@ -1,28 +1,50 @@
 // Simple logging. Each system call that might write the file system
 // should be surrounded with begin_trans() and commit_trans() calls.
 //
-// The log holds at most one transaction at a time. Commit forces
-// the log (with commit record) to disk, then installs the affected
-// blocks to disk, then erases the log. begin_trans() ensures that
-// only one system call can be in a transaction; others must wait.
+// Several system calls may join a transaction: begin_trans() admits a
+// call while the transaction has room for the sectors it may write,
+// MAXOPBLOCKS unless it asks for more with begin_trans_n(), beyond what
+// the calls already in it may write, and the last call to finish
+// commits the whole group. Calls that find the transaction full, or a
+// commit in progress, wait for the next group.
 //
-// Allowing only one transaction at a time means that the file
-// system code doesn't have to worry about the possibility of
-// one transaction reading a block that another one has modified,
-// for example an i-node block.
+// Committing the calls of a group together means that the file system
+// code doesn't have to worry about the possibility of one transaction
+// reading a block that another one has modified, for example an i-node
+// block: both reach the disk atomically or neither does.
 //
 // Read-only system calls don't need to use transactions, though
 // this means that they may observe uncommitted data. I-node and
 // buffer locks prevent read-only calls from seeing inconsistent data.
 //
-// The log is a physical re-do log containing disk blocks.
-// The on-disk log format:
-//   header block, containing sector #s for block A, B, C, ...
-//   block A
-//   block B
-//   block C
-//   ...
-// Log appends are synchronous.
+// The log is a physical re-do journal containing disk blocks, written
+// circularly. The on-disk log format:
+//   log superblock: sequence number and position of the oldest record
+//   record: descriptor block, containing the sequence number, sector #s
+//           for block A, B, C, ... and a checksum over all of them
+//           block A
+//           block B
+//           ...
+//   record: ...
+// log_write() only records and pins the modified buffers. Commit copies
+// them and their descriptor to the next free stretch of the journal and
+// waits for a single flush barrier: the checksum tells recovery whether
+// every sector of a record made it, so no ordering within it matters.
+// The committed blocks are then installed into the buffer cache, which
+// writes them home lazily. Only when the journal runs short of room does
+// begin_trans() checkpoint it, waiting for the installed blocks to reach
+// the disk and advancing the log superblock past their records.
+//
+// Recovery replays the records from the log superblock on, in sequence,
+// up to the first one whose sequence number or checksum does not match.
+//
+// In ordered mode, chosen when the log is mounted at boot, file data
+// skips the log: log_write_data() writes it in place, and commit waits
+// for it to reach the disk before writing the record of the metadata
+// that points to it. A data block is still logged if a replay could
+// write over it, that is if it was logged or freed since the last
+// checkpoint; that is when it last served as metadata or belonged to a
+// file whose removal may not be committed yet.
 
 #ifndef _KERN_FS_LOG_H_
 #define _KERN_FS_LOG_H_
@@ -30,16 +52,35 @@
 #ifdef _KERN_
 
 #include <lib/buf.h>
+#include <kern/lib/syscall.h>
 
 void log_init(void);
 
+// Called at the start of each FS system call. Joins the open
+// transaction once it has room for another MAXOPBLOCKS sectors.
 void begin_trans(void);
 
+// Called at the end of each FS system call. The last call of the group
+// commits it.
 void commit_trans(void);
 
+// Like begin_trans() and commit_trans(), for a system call that may
+// write up to nsectors distinct sectors instead of MAXOPBLOCKS.
+void begin_trans_n(int nsectors);
+void commit_trans_n(int nsectors);
+
+// Most distinct sectors a file_write() of n bytes may log.
+int log_write_sectors(uint32_t n);
+
+// Bytes a file_write() transaction may carry, from the size of the log.
+uint32_t log_max_write(void);
+
+// Copy the transaction statistics to *stat, and clear them if reset.
+void log_get_stat(struct logstat *stat, bool reset);
+
 // Caller has modified b->data and is done with the buffer.
-// Append the block to the log and record the block number,
-// but don't write the log header (which would commit the write).
+// Record the block number and pin the buffer in the cache; commit
+// copies it to the log. No disk I/O happens here.
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bufcache_read(...)
 //   modify bp->data[]
@@ -47,6 +88,14 @@ void commit_trans(void);
 //   bufcache_release(bp)
 void log_write(struct buf *b);
 
+// Like log_write(), for a block of file data. In ordered mode it is
+// written in place, before the transaction commits, unless a replay
+// could write over it.
+void log_write_data(struct buf *b);
+
+// Block b of device dev has been freed by the open transaction.
+void log_free(uint32_t dev, uint32_t b);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_FS_LOG_H_ */
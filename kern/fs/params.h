@@ -5,12 +5,15 @@
 
 #define NOFILE  16  // open files per process
 #define NFILE   100 // open files per system
-#define NBUF    10  // size of disk block cache
+#define NBUF    64  // minimum size of disk block cache
+#define BUFCACHE_SHARE 16  // disk block cache gets 1/16 of free memory
 #define NINODE  50  // maximum number of active i-nodes
+#define NIMAP   8192  // maximum number of i-nodes on a device
+#define NDENTRY 512 // entries of the directory entry cache
 #define NDEV    10  // maximum major device number
 #define ROOTDEV 1   // device number of file system root disk
 #define MAXARG  32  // max exec arguments
-#define LOGSIZE 10  // max data sectors in on-disk log
+#define MAXOPBLOCKS 10  // max sectors any FS system call writes
 
 #define ROOTINO 1    // root i-number
 #define BSIZE   512  // block size
@@ -17,6 +17,7 @@
 #include <thread/PCurID/export.h>
 #include "inode.h"
 #include "dir.h"
+#include "dcache.h"
 #include "log.h"
 
 // Paths
@@ -92,7 +93,19 @@ static struct inode *namex(char *path, bool nameiparent, char *name)
     }
 
     while ((path = skipelem(path, name)) != 0) {
-        // TODO
+        // Only directories have entries in the dentry cache, and ip stays
+        // one while they are there: a hit needs no lock on ip.
+        if (!(nameiparent && *path == '\0')
+            && dcache_lookup(ip->dev, ip->inum, name, &dir)) {
+            if (dir == 0) {
+                inode_put(ip);
+                return 0;
+            }
+            inode_put(ip);
+            ip = dir;
+            continue;
+        }
+
         inode_lock(ip);
 
         if(ip->type != T_DIR){
@@ -16,10 +16,16 @@
 #include "file.h"
 #include "fcntl.h"
 #include "log.h"
+#include "bufcache.h"
 
-char kernel_buf[50000];
-// extern char sys_buf[NUM_IDS][PAGESIZE];
-extern spinlock_t fs_lock;
+extern char sys_buf[NUM_IDS][PAGESIZE];
+
+// Sectors a call creating a name may write: dir_link's, plus the new
+// inode's block, and for a directory its first block and that block's
+// bitmap block.
+#define CREATE_BLOCKS (DIRLINK_BLOCKS + 3)
+// Sectors sys_link may write: dir_link's, plus the linked inode's block.
+#define LINK_BLOCKS   (DIRLINK_BLOCKS + 1)
 
 /**
  * This function is not a system call handler, but an auxiliary function
@@ -55,56 +61,57 @@ static int fdalloc(struct file *f)
  */
 void sys_read(tf_t *tf)
 {
-    // TODO
     int fd = (int)syscall_get_arg2(tf);
     unsigned int user_buf = syscall_get_arg3(tf);
     unsigned int n = syscall_get_arg4(tf);
-
-    if (n < 0 || n > sizeof(kernel_buf)){
-        KERN_INFO("size error, sys_read\n");
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
-        return;
-    }
-
-    spinlock_acquire(&fs_lock);
+    unsigned int pid = get_curid();
+    struct file * fp;
+    unsigned int done, n1;
+    int r;
 
     if(fd < 0 || fd >= NOFILE){
         KERN_INFO("fd error, sys_read\n");
         syscall_set_errno(tf, E_BADF);
         syscall_set_retval1(tf, -1);
-        spinlock_release(&fs_lock);
         return;
     }
 
-    if (user_buf < VM_USERLO || user_buf + n > VM_USERHI){
+    if (user_buf < VM_USERLO || user_buf > VM_USERHI || n > VM_USERHI - user_buf){
         KERN_INFO("user buffer error, sys_read\n");
         syscall_set_errno(tf, E_INVAL_ADDR);
         syscall_set_retval1(tf, -1);
-        spinlock_release(&fs_lock);
         return;
     }
 
-    unsigned int pid = get_curid();
-    struct file * fp;
-    int size_read;
-
     fp = tcb_get_openfiles(pid)[fd];
     if(fp == 0 || fp->ip == 0){
         KERN_INFO("fd error, sys_read\n");
         syscall_set_errno(tf, E_BADF);
         syscall_set_retval1(tf, -1);
-        spinlock_release(&fs_lock);
         return;
     } 
 
-    size_read = file_read(fp, kernel_buf, n);
-    if(size_read > 0)
-        pt_copyout(kernel_buf, get_curid(), user_buf, size_read); 
+    /*
+     * Read through the caller's own bounce page, one page at a time.
+     * Only this file and the inode being read are locked, and both are
+     * sleeping locks, so reads of other files go on meanwhile.
+     */
+    file_lock(fp);
+    done = 0;
+    r = 0;
+    while (done < n) {
+        n1 = n - done < PAGESIZE ? n - done : PAGESIZE;
+        if ((r = file_read(fp, sys_buf[pid], n1)) <= 0)
+            break;
+        pt_copyout(sys_buf[pid], pid, user_buf + done, r);
+        done += r;
+        if (r < n1)
+            break;
+    }
+    file_unlock(fp);
 
-    syscall_set_retval1(tf, size_read);
+    syscall_set_retval1(tf, (r < 0 && done == 0) ? -1 : done);
     syscall_set_errno(tf, E_SUCC);
-    spinlock_release(&fs_lock);
     return;
 }
 
@@ -119,54 +126,51 @@ void sys_read(tf_t *tf)
  */
 void sys_write(tf_t *tf)
 {
-    // TODO
     int fd = (int)syscall_get_arg2(tf);
     unsigned int user_buf = syscall_get_arg3(tf);
     unsigned n = syscall_get_arg4(tf);
-
-    if (n < 0 || n > sizeof(kernel_buf)){
-        KERN_INFO("size error, sys_write\n");
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
-        return;
-    }
-
-    spinlock_acquire(&fs_lock);
+    unsigned int pid = get_curid();
+    struct file * fp;
+    unsigned int done, n1;
+    int r;
 
     if(fd < 0 || fd >= NOFILE){
         KERN_INFO("fd error, sys_write\n");
         syscall_set_errno(tf, E_BADF);
         syscall_set_retval1(tf, -1);
-        spinlock_release(&fs_lock);
         return;
     }
 
-    if (user_buf < VM_USERLO || user_buf + n > VM_USERHI){
+    if (user_buf < VM_USERLO || user_buf > VM_USERHI || n > VM_USERHI - user_buf){
         KERN_INFO("user buffer error, sys_write\n");
         syscall_set_errno(tf, E_INVAL_ADDR);
         syscall_set_retval1(tf, -1);
-        spinlock_release(&fs_lock);
         return;
     }
 
-    unsigned int pid = get_curid();
-    struct file * fp;
-    int size_wrote;
-
     fp = tcb_get_openfiles(pid)[fd];
     if(fp == 0 || fp->ip == 0){
         KERN_INFO("tcb open files error, sys_write\n");
         syscall_set_errno(tf, E_BADF);
         syscall_set_retval1(tf, -1);
-        spinlock_release(&fs_lock);
         return;
     } 
 
-    pt_copyin(pid, user_buf, kernel_buf, n); 
-    size_wrote = file_write(fp, kernel_buf, n);
-    syscall_set_retval1(tf, size_wrote);
+    // Same as sys_read: a page at a time through the caller's bounce page.
+    file_lock(fp);
+    done = 0;
+    r = 0;
+    while (done < n) {
+        n1 = n - done < PAGESIZE ? n - done : PAGESIZE;
+        pt_copyin(pid, user_buf + done, sys_buf[pid], n1);
+        if ((r = file_write(fp, sys_buf[pid], n1)) < 0)
+            break;
+        done += r;
+    }
+    file_unlock(fp);
+
+    syscall_set_retval1(tf, r < 0 ? -1 : done);
     syscall_set_errno(tf, E_SUCC);
-    spinlock_release(&fs_lock);
     return;
 }
 
@@ -263,12 +267,12 @@ void sys_link(tf_t * tf)
         return;
     }
 
-    begin_trans();
+    begin_trans_n(LINK_BLOCKS);
 
     inode_lock(ip);
     if (ip->type == T_DIR) {
         inode_unlockput(ip);
-        commit_trans();
+        commit_trans_n(LINK_BLOCKS);
         syscall_set_errno(tf, E_DISK_OP);
         return;
     }
@@ -287,7 +291,7 @@ void sys_link(tf_t * tf)
     inode_unlockput(dp);
     inode_put(ip);
 
-    commit_trans();
+    commit_trans_n(LINK_BLOCKS);
 
     syscall_set_errno(tf, E_SUCC);
     return;
@@ -297,7 +301,7 @@ bad:
     ip->nlink--;
     inode_update(ip);
     inode_unlockput(ip);
-    commit_trans();
+    commit_trans_n(LINK_BLOCKS);
     syscall_set_errno(tf, E_DISK_OP);
     return;
 }
@@ -322,7 +326,6 @@ static int isdirempty(struct inode *dp)
 void sys_unlink(tf_t *tf)
 {
     struct inode *ip, *dp;
-    struct dirent de;
     char name[DIRSIZ], path[128];
     uint32_t off;
 
@@ -352,9 +355,7 @@ void sys_unlink(tf_t *tf)
         goto bad;
     }
 
-    memset(&de, 0, sizeof(de));
-    if (inode_write(dp, (char *) &de, off, sizeof(de)) != sizeof(de))
-        KERN_PANIC("unlink: writei");
+    dir_unlink(dp, name, off);
     if (ip->type == T_DIR) {
         dp->nlink--;
         inode_update(dp);
@@ -396,7 +397,7 @@ static struct inode *create(char *path, short type, short major, short minor)
         return 0;
     }
 
-    if ((ip = inode_alloc(dp->dev, type)) == 0)
+    if ((ip = inode_alloc(dp->dev, type, dp->inum)) == 0)
         KERN_PANIC("create: ialloc");
 
     inode_lock(ip);
@@ -432,9 +433,9 @@ void sys_open(tf_t *tf)
     omode = syscall_get_arg3(tf);
 
     if (omode & O_CREATE) {
-        begin_trans();
+        begin_trans_n(CREATE_BLOCKS);
         ip = create(path, T_FILE, 0, 0);
-        commit_trans();
+        commit_trans_n(CREATE_BLOCKS);
         if (ip == 0) {
             syscall_set_retval1(tf, -1);
             syscall_set_errno(tf, E_CREATE);
@@ -481,14 +482,14 @@ void sys_mkdir(tf_t *tf)
 
     pt_copyin(get_curid(), syscall_get_arg2(tf), path, 128);
 
-    begin_trans();
+    begin_trans_n(CREATE_BLOCKS);
     if ((ip = (struct inode *) create(path, T_DIR, 0, 0)) == 0) {
-        commit_trans();
+        commit_trans_n(CREATE_BLOCKS);
         syscall_set_errno(tf, E_DISK_OP);
         return;
     }
     inode_unlockput(ip);
-    commit_trans();
+    commit_trans_n(CREATE_BLOCKS);
     syscall_set_errno(tf, E_SUCC);
 }
 
@@ -515,3 +516,45 @@ void sys_chdir(tf_t *tf)
     tcb_set_cwd(pid, ip);
     syscall_set_errno(tf, E_SUCC);
 }
+
+/**
+ * Copies the buffer cache statistics to the struct bufstat at user address
+ * a[1], unless it is 0, then clears the lookup counters if a[0] is nonzero.
+ */
+void sys_bufstat(tf_t *tf)
+{
+    struct bufstat stat;
+    uintptr_t uva = syscall_get_arg3(tf);
+
+    if (uva != 0) {
+        bufcache_get_stat(&stat);
+        if (pt_copyout(&stat, get_curid(), uva, sizeof(stat)) != sizeof(stat)) {
+            syscall_set_errno(tf, E_INVAL_ADDR);
+            return;
+        }
+    }
+    if (syscall_get_arg2(tf))
+        bufcache_reset_stat();
+    syscall_set_errno(tf, E_SUCC);
+}
+
+/**
+ * Copies the log statistics to the struct logstat at user address a[1],
+ * unless it is 0, then clears them if a[0] is nonzero.
+ */
+void sys_logstat(tf_t *tf)
+{
+    struct logstat stat;
+    uintptr_t uva = syscall_get_arg3(tf);
+
+    if (uva != 0) {
+        log_get_stat(&stat, FALSE);
+        if (pt_copyout(&stat, get_curid(), uva, sizeof(stat)) != sizeof(stat)) {
+            syscall_set_errno(tf, E_INVAL_ADDR);
+            return;
+        }
+    }
+    if (syscall_get_arg2(tf))
+        log_get_stat(NULL, TRUE);
+    syscall_set_errno(tf, E_SUCC);
+}
@@ -16,6 +16,8 @@ void sys_unlink(tf_t *tf);
 void sys_open(tf_t *tf);
 void sys_mkdir(tf_t *tf);
 void sys_chdir(tf_t *tf);
+void sys_bufstat(tf_t *tf);
+void sys_logstat(tf_t *tf);
 
 #endif  /* _KERN_ */
 
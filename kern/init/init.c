@@ -1,9 +1,11 @@
 #include <lib/debug.h>
 #include <lib/types.h>
 #include <lib/kstack.h>
+#include <lib/lockbench.h>
 #include <lib/thread.h>
 #include <lib/x86.h>
 #include <dev/devinit.h>
+#include <fs/bufcache.h>
 #include <pcpu/PCPUIntro/export.h>
 #include <proc/PProc/export.h>
 #include <thread/PCurID/export.h>
@@ -13,6 +15,7 @@
 #include <thread/PThread/export.h>
 
 extern uint32_t pcpu_ncpu(void);
+extern int pcpu_boot_ap(uint32_t cpu_idx, void (*f)(void), uintptr_t stack_addr);
 
 static volatile int cpu_booted = 0;
 static volatile int all_ready = FALSE;
@@ -20,6 +23,29 @@ static volatile int all_ready = FALSE;
 extern uint8_t _binary___obj_user_idle_idle_start[];
 extern uint8_t _binary___obj_user_shell_shell_start[];
 
+static void kern_main_ap(void);
+
+#ifdef LOCKBENCH
+/**
+ * Boots the APs and runs the lock microbenchmark on every CPU. The APs halt
+ * afterwards since processes are only scheduled on the BSP.
+ */
+static void kern_lockbench(void)
+{
+    uint32_t i, ncpu = pcpu_ncpu();
+
+    for (i = 1; i < ncpu; i++) {
+        bsp_kstack[i].cpu_idx = i;
+        pcpu_boot_ap(i, kern_main_ap, (uintptr_t) &bsp_kstack[i]);
+    }
+    all_ready = TRUE;
+    while (cpu_booted < ncpu - 1)
+        pause();
+
+    lockbench_run(0, ncpu);
+}
+#endif
+
 static void kern_main(void)
 {
     KERN_INFO("[BSP KERN] In kernel main.\n\n");
@@ -29,11 +55,17 @@ static void kern_main(void)
     int cpu_idx = get_pcpu_idx();
     unsigned int pid;
 
+#ifdef LOCKBENCH
+    kern_lockbench();
+#endif
+
     pid = proc_create(_binary___obj_user_idle_idle_start, 10000);
     KERN_INFO("CPU%d: process idle %d is created.\n", cpu_idx, pid);
 
-    pid = proc_create (_binary___obj_user_shell_shell_start, 10000);
+    pid = proc_create (_binary___obj_user_shell_shell_start, 65536);
     KERN_INFO("CPU%d: process shell %d is created.\n", cpu_idx, pid);
+
+    bufcache_start_flusher();
     
     tqueue_remove(NUM_IDS, pid);
     tcb_set_state(pid, TSTATE_RUN);
@@ -53,12 +85,20 @@ static void kern_main_ap(void)
 
     KERN_INFO("[AP%d KERN] kernel_main_ap\n", cpu_idx);
 
-    cpu_booted++;
+    xadd((volatile uint32_t *) &cpu_booted, 1);
+
+#ifdef LOCKBENCH
+    lockbench_run(cpu_idx, pcpu_ncpu());
+#endif
+
+    while (1)
+        halt();
 }
 
 void kern_init(uintptr_t mbi_addr)
 {
     thread_init(mbi_addr);
+    bufcache_init();  // sized from the memory left after the allocator is up
     KERN_INFO("[BSP KERN] Kernel initialized.\n");
     kern_main();
 }
@@ -3,19 +3,31 @@
 
 #ifdef _KERN_
 
+#include <lib/mutex.h>
+
 struct buf {
     int32_t flags;
     int dev;
     uint32_t sector;
-    struct buf *prev;   // LRU cache list
+    uint32_t refcnt;    // holders and waiters; pins dev and sector
+    uint32_t pincnt;    // log transactions holding it in memory
+    mutex_t lock;       // held between bufcache_read and bufcache_release
+    struct buf *prev;   // replacement queue
     struct buf *next;
+    uint32_t queue;     // which one, probation or protected
+    uint32_t stamp;     // release clock when it went on probation
+    struct buf *hnext;  // hash bucket chain
+    struct buf *dprev;  // dirty list, oldest first; NULL if not on it
+    struct buf *dnext;
+    uint64_t dirtied;   // TSC when it joined the dirty list
     struct buf *qnext;  // disk queue
-    uint8_t data[512];
+    struct buf *rnext;  // next buf of a multi-sector write
+    uint8_t *data;      // BSIZE bytes within a page shared with other bufs
 };
 
-#define B_BUSY  0x1  // buffer is locked by some process
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
+#define B_META  0x8  // buffer holds file system metadata
 
 #endif  /* _KERN_ */
 
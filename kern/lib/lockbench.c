@@ -0,0 +1,120 @@
+#ifdef LOCKBENCH
+
+#include <lib/debug.h>
+#include <lib/gcc.h>
+#include <lib/types.h>
+#include <lib/spinlock.h>
+#include <lib/x86.h>
+
+#include "lockbench.h"
+
+extern volatile uint64_t tsc_per_ms;
+
+// Length of one measurement window in milliseconds.
+#define LOCKBENCH_MS    200
+// Work done inside and between critical sections, in loop iterations.
+#define LOCKBENCH_CS    16
+#define LOCKBENCH_DELAY 64
+
+struct lockbench_cpu {
+    volatile uint32_t count;
+} gcc_aligned(64);
+
+static spinlock_t bench_lk;
+static struct lockbench_cpu bench_cpu[NUM_CPUS];
+static volatile uint32_t bench_shared;
+static volatile uint64_t bench_deadline;
+
+static volatile uint32_t barrier_arrived;
+static volatile uint32_t barrier_gen;
+
+static const char *bench_names[] = { "tas", "ticket", "mcs" };
+
+/**
+ * Spins until all ncpu CPUs have arrived.
+ */
+static void lockbench_barrier(uint32_t ncpu)
+{
+    uint32_t gen = barrier_gen;
+
+    if (xadd(&barrier_arrived, 1) == ncpu - 1) {
+        barrier_arrived = 0;
+        xchg(&barrier_gen, gen + 1);
+    } else {
+        while (barrier_gen == gen)
+            pause();
+    }
+}
+
+static void lockbench_delay(uint32_t n)
+{
+    volatile uint32_t i;
+
+    for (i = 0; i < n; i++);
+}
+
+/**
+ * Hammers bench_lk on the current CPU until bench_deadline.
+ */
+static void lockbench_loop(uint32_t cpu_idx)
+{
+    uint32_t count = 0;
+
+    while (rdtsc() < bench_deadline) {
+        spinlock_acquire(&bench_lk);
+        bench_shared++;
+        lockbench_delay(LOCKBENCH_CS);
+        spinlock_release(&bench_lk);
+        count++;
+        lockbench_delay(LOCKBENCH_DELAY);
+    }
+
+    bench_cpu[cpu_idx].count = count;
+}
+
+static void lockbench_report(uint32_t type, uint32_t ncpu)
+{
+    uint32_t i, total = 0, min = 0xFFFFFFFF, max = 0;
+
+    for (i = 0; i < ncpu; i++) {
+        total += bench_cpu[i].count;
+        if (bench_cpu[i].count < min)
+            min = bench_cpu[i].count;
+        if (bench_cpu[i].count > max)
+            max = bench_cpu[i].count;
+    }
+
+    KERN_INFO("[LOCKBENCH] %s: %d CPUs, %d acquisitions/s, "
+              "per-CPU min %d max %d spread %d\n",
+              bench_names[type], ncpu, total / LOCKBENCH_MS * 1000,
+              min, max, max - min);
+    if (bench_shared != total)
+        KERN_WARN("[LOCKBENCH] %s: lost updates (%d != %d)\n",
+                  bench_names[type], bench_shared, total);
+}
+
+/**
+ * Runs the lock microbenchmark; every CPU in [0, ncpu) must call this,
+ * CPU 0 prints the results.
+ */
+void lockbench_run(uint32_t cpu_idx, uint32_t ncpu)
+{
+    uint32_t type;
+
+    for (type = SPINLOCK_TAS; type <= SPINLOCK_MCS; type++) {
+        if (cpu_idx == 0) {
+            spinlock_init_type(&bench_lk, type);
+            bench_shared = 0;
+            bench_deadline = rdtsc() + tsc_per_ms * (LOCKBENCH_MS + 1);
+        }
+        lockbench_barrier(ncpu);
+
+        lockbench_loop(cpu_idx);
+        lockbench_barrier(ncpu);
+
+        if (cpu_idx == 0)
+            lockbench_report(type, ncpu);
+    }
+}
+
+#endif  /* LOCKBENCH */
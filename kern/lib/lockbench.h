@@ -0,0 +1,16 @@
+#ifndef _KERN_LIB_LOCKBENCH_H_
+#define _KERN_LIB_LOCKBENCH_H_
+
+#ifdef _KERN_
+
+#ifdef LOCKBENCH
+
+#include <lib/types.h>
+
+void lockbench_run(uint32_t cpu_idx, uint32_t ncpu);
+
+#endif  /* LOCKBENCH */
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_LOCKBENCH_H_ */
@@ -0,0 +1,235 @@
+#ifdef LOCKSTAT
+
+#include <lib/debug.h>
+#include <lib/gcc.h>
+#include <lib/kstack.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+
+#include "lockstat.h"
+
+// Call sites tracked per CPU, a power of two.
+#define LOCKSTAT_SITES 256
+// Rows printed per section of the dump.
+#define LOCKSTAT_ROWS  32
+
+struct lockstat_site {
+    spinlock_t *lk;
+    const char *file;
+    int line;
+    uint32_t acquisitions;
+    uint32_t contended;
+    uint64_t spin_cycles;
+    uint64_t max_hold;
+};
+
+struct lockstat_cpu {
+    struct lockstat_site sites[LOCKSTAT_SITES];
+    uint32_t dropped;  // acquisitions not recorded because the table was full
+    uint32_t gen;      // lockstat_gen when the table was last cleared
+};
+
+static struct lockstat_cpu lockstat_cpus[NUM_CPUS];
+
+/*
+ * Bumped by lockstat_reset. Each CPU clears its own table when it sees a
+ * new generation, since only it updates the table; the dump skips tables
+ * not yet cleared.
+ */
+static volatile uint32_t lockstat_gen;
+
+/*
+ * Scratch tables for the dump, merged over all CPUs. Serialized by
+ * lockstat_lk, which is itself counted like any other lock.
+ */
+static struct lockstat_site merged_sites[LOCKSTAT_SITES];
+static struct lockstat_site merged_locks[LOCKSTAT_SITES];
+static spinlock_t lockstat_lk;
+
+static uint32_t lockstat_hash(spinlock_t *lk, const char *file, int line)
+{
+    return ((uint32_t) lk >> 2) ^ ((uint32_t) file >> 2) ^ (line * 31);
+}
+
+/**
+ * Finds or creates the entry of (lk, file, line) in an open-addressed table.
+ * Returns NULL if the table is full.
+ */
+static struct lockstat_site *lockstat_lookup(struct lockstat_site *sites,
+                                             spinlock_t *lk, const char *file,
+                                             int line)
+{
+    uint32_t i, idx = lockstat_hash(lk, file, line);
+    struct lockstat_site *site;
+
+    for (i = 0; i < LOCKSTAT_SITES; i++) {
+        site = &sites[(idx + i) & (LOCKSTAT_SITES - 1)];
+        if (site->lk == NULL) {
+            site->lk = lk;
+            site->file = file;
+            site->line = line;
+            return site;
+        }
+        if (site->lk == lk && site->file == file && site->line == line)
+            return site;
+    }
+    return NULL;
+}
+
+/**
+ * Records an acquisition of lk at file:line by the current CPU.
+ * [spin] is the number of TSC cycles spent waiting for the lock.
+ */
+void lockstat_acquired(spinlock_t *lk, const char *file, int line,
+                       bool contended, uint64_t spin)
+{
+    struct lockstat_cpu *cpu = &lockstat_cpus[get_kstack_cpu_idx()];
+    struct lockstat_site *site;
+    uint32_t gen = lockstat_gen;
+
+    if (cpu->gen != gen) {
+        memzero(cpu->sites, sizeof(cpu->sites));
+        cpu->dropped = 0;
+        cpu->gen = gen;
+    }
+
+    site = lockstat_lookup(cpu->sites, lk, file, line);
+    lk->stat_site = site;
+    lk->stat_start = rdtsc();
+    if (site == NULL) {
+        cpu->dropped++;
+        return;
+    }
+
+    site->acquisitions++;
+    if (contended) {
+        site->contended++;
+        site->spin_cycles += spin;
+    }
+}
+
+/**
+ * Charges the hold time of lk to the call site that acquired it.
+ */
+void lockstat_releasing(spinlock_t *lk)
+{
+    struct lockstat_site *site = lk->stat_site;
+    uint64_t hold;
+
+    /* the tables may have been reset while lk was held */
+    if (site == NULL || site->lk != lk)
+        return;
+
+    hold = rdtsc() - lk->stat_start;
+    if (hold > site->max_hold)
+        site->max_hold = hold;
+    lk->stat_site = NULL;
+}
+
+static void lockstat_merge(struct lockstat_site *to, struct lockstat_site *from)
+{
+    to->acquisitions += from->acquisitions;
+    to->contended += from->contended;
+    to->spin_cycles += from->spin_cycles;
+    if (from->max_hold > to->max_hold)
+        to->max_hold = from->max_hold;
+}
+
+/**
+ * Packs the used entries of a table to its front, sorted by spin cycles
+ * and then by contended acquisitions, hottest first. Returns their number.
+ */
+static uint32_t lockstat_sort(struct lockstat_site *sites)
+{
+    uint32_t i, j, n = 0;
+    struct lockstat_site tmp;
+
+    for (i = 0; i < LOCKSTAT_SITES; i++)
+        if (sites[i].lk != NULL)
+            sites[n++] = sites[i];
+
+    for (i = 1; i < n; i++) {
+        tmp = sites[i];
+        for (j = i; j > 0; j--) {
+            if (sites[j - 1].spin_cycles > tmp.spin_cycles
+                || (sites[j - 1].spin_cycles == tmp.spin_cycles
+                    && sites[j - 1].contended >= tmp.contended))
+                break;
+            sites[j] = sites[j - 1];
+        }
+        sites[j] = tmp;
+    }
+    return n;
+}
+
+static void lockstat_print(struct lockstat_site *site)
+{
+    if (site->file != NULL)
+        KERN_INFO("  %s:%d lock 0x%08x acq %u cont %u spin %llu maxhold %llu\n",
+                  site->file, site->line, site->lk, site->acquisitions,
+                  site->contended, site->spin_cycles, site->max_hold);
+    else
+        KERN_INFO("  lock 0x%08x acq %u cont %u spin %llu maxhold %llu\n",
+                  site->lk, site->acquisitions, site->contended,
+                  site->spin_cycles, site->max_hold);
+}
+
+/**
+ * Prints the statistics of all CPUs, per lock and per call site, sorted by
+ * the cycles spent spinning. Times are in TSC cycles.
+ */
+void lockstat_dump(void)
+{
+    uint32_t cpu, i, n, dropped = 0;
+    struct lockstat_site *site, *to;
+
+    spinlock_acquire(&lockstat_lk);
+
+    memzero(merged_sites, sizeof(merged_sites));
+    memzero(merged_locks, sizeof(merged_locks));
+    for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+        if (lockstat_cpus[cpu].gen != lockstat_gen)
+            continue;  // reset, and no lock taken on it since
+        dropped += lockstat_cpus[cpu].dropped;
+        for (i = 0; i < LOCKSTAT_SITES; i++) {
+            site = &lockstat_cpus[cpu].sites[i];
+            if (site->lk == NULL)
+                continue;
+            to = lockstat_lookup(merged_sites, site->lk, site->file, site->line);
+            if (to != NULL)
+                lockstat_merge(to, site);
+            to = lockstat_lookup(merged_locks, site->lk, NULL, 0);
+            if (to != NULL)
+                lockstat_merge(to, site);
+        }
+    }
+
+    KERN_INFO("lockstat: per lock\n");
+    n = lockstat_sort(merged_locks);
+    for (i = 0; i < n && i < LOCKSTAT_ROWS; i++)
+        lockstat_print(&merged_locks[i]);
+
+    KERN_INFO("lockstat: per call site\n");
+    n = lockstat_sort(merged_sites);
+    for (i = 0; i < n && i < LOCKSTAT_ROWS; i++)
+        lockstat_print(&merged_sites[i]);
+
+    if (dropped)
+        KERN_INFO("lockstat: %u acquisitions not recorded\n", dropped);
+
+    spinlock_release(&lockstat_lk);
+}
+
+/**
+ * Clears the statistics of all CPUs. Each CPU clears its own table on its
+ * next acquisition, so that no update races with the clearing.
+ */
+void lockstat_reset(void)
+{
+    spinlock_acquire(&lockstat_lk);
+    lockstat_gen++;
+    spinlock_release(&lockstat_lk);
+}
+
+#endif  /* LOCKSTAT */
@@ -0,0 +1,21 @@
+#ifndef _KERN_LIB_LOCKSTAT_H_
+#define _KERN_LIB_LOCKSTAT_H_
+
+#ifdef _KERN_
+
+#ifdef LOCKSTAT
+
+#include <lib/types.h>
+#include <lib/spinlock.h>
+
+void lockstat_acquired(spinlock_t *lk, const char *file, int line,
+                       bool contended, uint64_t spin);
+void lockstat_releasing(spinlock_t *lk);
+void lockstat_dump(void);
+void lockstat_reset(void);
+
+#endif  /* LOCKSTAT */
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_LOCKSTAT_H_ */
@@ -0,0 +1,27 @@
+#ifndef _KERN_LIB_MUTEX_H_
+#define _KERN_LIB_MUTEX_H_
+
+#ifdef _KERN_
+
+#include <lib/types.h>
+#include <lib/spinlock.h>
+
+/*
+ * Sleeping mutex, implemented by the thread layer (mutex_lock() and friends
+ * in thread/PThread). A contended locker spins for a short while if the
+ * holder is running on another CPU, and otherwise sleeps in FIFO order on
+ * the mutex's own wait queue. Unlocking hands the mutex to the first
+ * sleeper and wakes only that one.
+ * Must be set up with mutex_init() before use.
+ */
+typedef struct {
+    spinlock_t lk;            // protects the wait queue and handoffs
+    volatile uint32_t locked;
+    volatile uint32_t owner;  // pid of the holder
+    uint32_t head;            // first sleeping waiter, NUM_IDS if none
+    uint32_t tail;
+} mutex_t;
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_MUTEX_H_ */
@@ -0,0 +1,57 @@
+#include <lib/debug.h>
+#include <lib/kstack.h>
+#include <lib/string.h>
+#include <lib/x86.h>
+
+#include "rwlock.h"
+
+void rwlock_init(rwlock_t *lk)
+{
+    memzero((void *) lk->readers, sizeof(lk->readers));
+    lk->writer = 0;
+    spinlock_init(&lk->wlock);
+}
+
+void rwlock_read_acquire(rwlock_t *lk)
+{
+    volatile uint32_t *count = &lk->readers[get_kstack_cpu_idx()].count;
+
+    while (1) {
+        /*
+         * The locked add orders the count before the read of [writer].
+         * A nested reader must not back off, or a waiting writer would
+         * wait for it forever.
+         */
+        if (xadd(count, 1) != 0 || lk->writer == 0)
+            return;
+        xadd(count, -1);
+        while (lk->writer)
+            pause();
+    }
+}
+
+void rwlock_read_release(rwlock_t *lk)
+{
+    volatile uint32_t *count = &lk->readers[get_kstack_cpu_idx()].count;
+
+    KERN_ASSERT(*count > 0);
+    smp_wmb();
+    (*count)--;
+}
+
+void rwlock_write_acquire(rwlock_t *lk)
+{
+    int i;
+
+    spinlock_acquire(&lk->wlock);
+    xchg(&lk->writer, 1);
+    for (i = 0; i < NUM_CPUS; i++)
+        while (lk->readers[i].count)
+            pause();
+}
+
+void rwlock_write_release(rwlock_t *lk)
+{
+    xchg(&lk->writer, 0);
+    spinlock_release(&lk->wlock);
+}
@@ -0,0 +1,36 @@
+#ifndef _KERN_LIB_RWLOCK_H_
+#define _KERN_LIB_RWLOCK_H_
+
+#ifdef _KERN_
+
+#include <lib/gcc.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+
+/*
+ * Reader-writer spinlock for read-mostly data.
+ * Each CPU counts its readers on its own cache line, so readers on different
+ * CPUs never write a shared line. A writer announces itself in [writer] and
+ * waits for every per-CPU count to drain, which makes writing expensive.
+ * Readers nest on the same CPU; neither side may sleep while holding it.
+ */
+struct rwlock_reader {
+    volatile uint32_t count;
+} gcc_aligned(64);
+
+typedef struct {
+    struct rwlock_reader readers[NUM_CPUS];
+    volatile uint32_t writer;  // 1 while a writer holds or waits for the lock
+    spinlock_t wlock;          // serializes the writers
+} rwlock_t;
+
+void rwlock_init(rwlock_t *lk);
+void rwlock_read_acquire(rwlock_t *lk);
+void rwlock_read_release(rwlock_t *lk);
+void rwlock_write_acquire(rwlock_t *lk);
+void rwlock_write_release(rwlock_t *lk);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_RWLOCK_H_ */
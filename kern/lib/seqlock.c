@@ -0,0 +1,39 @@
+#include <lib/x86.h>
+
+#include "seqlock.h"
+
+void seqlock_init(seqlock_t *sl)
+{
+    sl->seq = 0;
+    spinlock_init(&sl->lock);
+}
+
+void seqlock_write_begin(seqlock_t *sl)
+{
+    spinlock_acquire(&sl->lock);
+    sl->seq++;
+    smp_wmb();
+}
+
+void seqlock_write_end(seqlock_t *sl)
+{
+    smp_wmb();
+    sl->seq++;
+    spinlock_release(&sl->lock);
+}
+
+uint32_t seqlock_read_begin(seqlock_t *sl)
+{
+    uint32_t seq;
+
+    while ((seq = sl->seq) & 1)
+        pause();
+    smp_rmb();
+    return seq;
+}
+
+bool seqlock_read_retry(seqlock_t *sl, uint32_t seq)
+{
+    smp_rmb();
+    return sl->seq != seq;
+}
@@ -0,0 +1,34 @@
+#ifndef _KERN_LIB_SEQLOCK_H_
+#define _KERN_LIB_SEQLOCK_H_
+
+#ifdef _KERN_
+
+#include <lib/gcc.h>
+#include <lib/types.h>
+#include <lib/spinlock.h>
+
+/*
+ * Sequence lock for small records that are read far more often than
+ * written. Writers serialize on [lock] and make [seq] odd while they update
+ * the record. Readers take no lock and never write: they copy the record
+ * and retry if the sequence number changed meanwhile.
+ *
+ *     do {
+ *         seq = seqlock_read_begin(&sl);
+ *         ... copy the protected fields ...
+ *     } while (seqlock_read_retry(&sl, seq));
+ */
+typedef struct {
+    volatile uint32_t seq;
+    spinlock_t lock;
+} seqlock_t;
+
+void seqlock_init(seqlock_t *sl);
+void seqlock_write_begin(seqlock_t *sl);
+void seqlock_write_end(seqlock_t *sl);
+uint32_t seqlock_read_begin(seqlock_t *sl);
+bool seqlock_read_retry(seqlock_t *sl, uint32_t seq);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_SEQLOCK_H_ */
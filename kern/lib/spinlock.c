@@ -4,13 +4,36 @@
 #include <lib/x86.h>
 
 #include "spinlock.h"
+#include "lockstat.h"
 
 extern volatile uint64_t tsc_per_ms;
 
-void gcc_inline spinlock_init(spinlock_t *lk)
+// Most MCS locks a CPU can hold or wait for at the same time.
+#define MCS_NODES_PER_CPU 8
+
+static struct mcs_node mcs_nodes[NUM_CPUS][MCS_NODES_PER_CPU];
+
+void gcc_inline spinlock_init_type(spinlock_t *lk, uint32_t type)
 {
     lk->lock_holder = NUM_CPUS + 1;
     lk->lock = 0;
+    lk->type = type;
+    lk->next = 0;
+    lk->owner = 0;
+    lk->tail = NULL;
+    lk->node = NULL;
+}
+
+void gcc_inline spinlock_init(spinlock_t *lk)
+{
+    spinlock_init_type(lk, SPINLOCK_TAS);
+}
+
+static gcc_inline uint32_t spinlock_cpu_idx(void)
+{
+    struct kstack *kstack = (struct kstack *) ROUNDDOWN(read_esp(), KSTACK_SIZE);
+    KERN_ASSERT(kstack->magic == KSTACK_MAGIC);
+    return kstack->cpu_idx;
 }
 
 bool gcc_inline spinlock_holding(spinlock_t *lk)
@@ -18,59 +41,178 @@ bool gcc_inline spinlock_holding(spinlock_t *lk)
     if (!lk->lock)
         return FALSE;
 
-    struct kstack *kstack = (struct kstack *) ROUNDDOWN(read_esp(), KSTACK_SIZE);
-    KERN_ASSERT(kstack->magic == KSTACK_MAGIC);
-    return lk->lock_holder == kstack->cpu_idx;
+    return lk->lock_holder == spinlock_cpu_idx();
 }
 
 #ifdef DEBUG_DEADLOCK
-void spinlock_acquire_A(spinlock_t *lk)
+#define SPIN_START(start) ((start) = rdtsc())
+#define SPIN_CHECK(lk, start)                                       \
+    do {                                                            \
+        if (rdtsc() - (start) > tsc_per_ms * 3000)                  \
+            KERN_WARN("Possible deadlock 0x%08x.\n", (lk));         \
+    } while (0)
+#else   /* DEBUG_DEADLOCK */
+#define SPIN_START(start) ((void) (start))
+#define SPIN_CHECK(lk, start)
+#endif  /* !DEBUG_DEADLOCK */
+
+static struct mcs_node *mcs_node_get(uint32_t cpu_idx)
 {
-    uint64_t start_tsc = rdtsc();
+    int i;
 
-    while (xchg(&lk->lock, 1) != 0) {
-        if (rdtsc() - start_tsc > tsc_per_ms * 3000)
-            KERN_WARN("Possible deadlock 0x%08x.\n", lk);
-        pause();
+    for (i = 0; i < MCS_NODES_PER_CPU; i++) {
+        if (!mcs_nodes[cpu_idx][i].used) {
+            mcs_nodes[cpu_idx][i].used = 1;
+            return &mcs_nodes[cpu_idx][i];
+        }
     }
-    struct kstack *kstack = (struct kstack *) ROUNDDOWN(read_esp(), KSTACK_SIZE);
-    KERN_ASSERT(kstack->magic == KSTACK_MAGIC);
-    lk->lock_holder = kstack->cpu_idx;
+    KERN_PANIC("CPU%d holds too many MCS locks.\n", cpu_idx);
+    return NULL;
 }
-#else   /* DEBUG_DEADLOCK */
-void gcc_inline spinlock_acquire_A(spinlock_t *lk)
+
+void spinlock_acquire_A(spinlock_t *lk)
 {
-    while (xchg(&lk->lock, 1) != 0)
-        pause();
+    uint64_t start_tsc = 0;
+    uint32_t cpu_idx = spinlock_cpu_idx();
+    uint32_t ticket;
+    struct mcs_node *node, *prev;
 
-    struct kstack *kstack = (struct kstack *) ROUNDDOWN(read_esp(), KSTACK_SIZE);
-    KERN_ASSERT(kstack->magic == KSTACK_MAGIC);
-    lk->lock_holder = kstack->cpu_idx;
+    SPIN_START(start_tsc);
+
+    switch (lk->type) {
+    case SPINLOCK_TICKET:
+        ticket = xadd(&lk->next, 1);
+        while (lk->owner != ticket) {
+            SPIN_CHECK(lk, start_tsc);
+            pause();
+        }
+        lk->lock = 1;
+        break;
+    case SPINLOCK_MCS:
+        node = mcs_node_get(cpu_idx);
+        node->next = NULL;
+        node->locked = 1;
+        prev = (struct mcs_node *) xchg((volatile uint32_t *) &lk->tail,
+                                        (uint32_t) node);
+        if (prev != NULL) {
+            prev->next = node;
+            while (node->locked) {
+                SPIN_CHECK(lk, start_tsc);
+                pause();
+            }
+        }
+        lk->node = node;
+        lk->lock = 1;
+        break;
+    default:
+        while (xchg(&lk->lock, 1) != 0) {
+            SPIN_CHECK(lk, start_tsc);
+            pause();
+        }
+        break;
+    }
+
+    lk->lock_holder = cpu_idx;
 }
-#endif  /* !DEBUG_DEADLOCK */
 
-int gcc_inline spinlock_try_acquire_A(spinlock_t *lk)
+/**
+ * Returns 0 if the lock is acquired, nonzero if it is already held.
+ */
+int spinlock_try_acquire_A(spinlock_t *lk)
 {
-    uint32_t old_val = xchg(&lk->lock, 1);
-    if (old_val == 0) {
-        struct kstack *kstack = (struct kstack *) ROUNDDOWN(read_esp(), KSTACK_SIZE);
-        KERN_ASSERT(kstack->magic == KSTACK_MAGIC);
-        lk->lock_holder = kstack->cpu_idx;
+    uint32_t cpu_idx = spinlock_cpu_idx();
+    uint32_t ticket;
+    struct mcs_node *node;
+
+    switch (lk->type) {
+    case SPINLOCK_TICKET:
+        ticket = lk->owner;
+        if (lk->next != ticket || cmpxchg(&lk->next, ticket, ticket + 1) != ticket)
+            return 1;
+        lk->lock = 1;
+        break;
+    case SPINLOCK_MCS:
+        node = mcs_node_get(cpu_idx);
+        node->next = NULL;
+        node->locked = 1;
+        if (cmpxchg((volatile uint32_t *) &lk->tail, 0, (uint32_t) node) != 0) {
+            node->used = 0;
+            return 1;
+        }
+        lk->node = node;
+        lk->lock = 1;
+        break;
+    default:
+        if (xchg(&lk->lock, 1) != 0)
+            return 1;
+        break;
     }
-    return old_val;
+
+    lk->lock_holder = cpu_idx;
+    return 0;
 }
 
-void gcc_inline spinlock_release_A(spinlock_t *lk)
+void spinlock_release_A(spinlock_t *lk)
 {
+    struct mcs_node *node;
+
     lk->lock_holder = NUM_CPUS + 1;
-    xchg(&lk->lock, 0);
+
+    switch (lk->type) {
+    case SPINLOCK_TICKET:
+        lk->lock = 0;
+        /* only the holder writes owner; the xchg orders the critical section */
+        xchg(&lk->owner, lk->owner + 1);
+        break;
+    case SPINLOCK_MCS:
+        node = lk->node;
+        lk->node = NULL;
+        lk->lock = 0;
+        if (node->next == NULL) {
+            if (cmpxchg((volatile uint32_t *) &lk->tail, (uint32_t) node, 0)
+                == (uint32_t) node) {
+                node->used = 0;
+                break;
+            }
+            /* a waiter swapped itself in but has not linked its node yet */
+            while (node->next == NULL)
+                pause();
+        }
+        xchg(&node->next->locked, 0);
+        node->used = 0;
+        break;
+    default:
+        xchg(&lk->lock, 0);
+        break;
+    }
 }
 
-#ifdef DEBUG_LOCKHOLDING
+#ifdef LOCKSTAT
+/**
+ * Acquires lk and records the acquisition for lockstat. A failed first try
+ * counts as contended; the cycles until the lock is granted count as spin.
+ */
+static void spinlock_acquire_stat(spinlock_t *lk, const char *file, int line)
+{
+    uint64_t start;
+
+    if (spinlock_try_acquire_A(lk) == 0) {
+        lockstat_acquired(lk, file, line, FALSE, 0);
+        return;
+    }
+
+    start = rdtsc();
+    spinlock_acquire_A(lk);
+    lockstat_acquired(lk, file, line, TRUE, rdtsc() - start);
+}
+#endif  /* LOCKSTAT */
+
+#if defined(DEBUG_LOCKHOLDING) || defined(LOCKSTAT)
 extern int vdprintf(const char *fmt, va_list ap);
 
 void spinlock_acquire_(spinlock_t *lk, ...)
 {
+#ifdef DEBUG_LOCKHOLDING
     if (spinlock_holding(lk)) {
         while (1) {
             if (rdtsc() % 3) {
@@ -81,28 +223,54 @@ void spinlock_acquire_(spinlock_t *lk, ...)
             }
         }
     }
+#endif
+
+#ifdef LOCKSTAT
+    va_list ap;
+    const char *file;
+    int line;
+
+    va_start(ap, lk);
+    file = va_arg(ap, const char *);
+    line = va_arg(ap, int);
+    va_end(ap);
 
+    spinlock_acquire_stat(lk, file, line);
+#else
     spinlock_acquire_A(lk);
+#endif
 }
 
 void spinlock_release_(spinlock_t *lk, const char *file, int line)
 {
+#ifdef DEBUG_LOCKHOLDING
     if (!spinlock_holding(lk)) {
         KERN_PANIC("Tried to release unheld lock at %s:%d\n", file, line);
     }
+#endif
 
+#ifdef LOCKSTAT
+    lockstat_releasing(lk);
+#endif
     spinlock_release_A(lk);
 }
 
 int spinlock_try_acquire_(spinlock_t *lk, const char *file, int line)
 {
+#ifdef DEBUG_LOCKHOLDING
     if (spinlock_holding(lk)) {
         KERN_PANIC("Tried to self-deadlock at %s:%d\n", file, line);
     }
+#endif
 
-    return spinlock_try_acquire_A(lk);
+    if (spinlock_try_acquire_A(lk) != 0)
+        return 1;
+#ifdef LOCKSTAT
+    lockstat_acquired(lk, file, line, FALSE, 0);
+#endif
+    return 0;
 }
-#else   /* DEBUG_LOCKHOLDING */
+#else   /* DEBUG_LOCKHOLDING || LOCKSTAT */
 void gcc_inline spinlock_acquire(spinlock_t *lk)
 {
     spinlock_acquire_A(lk);
@@ -117,4 +285,4 @@ int gcc_inline spinlock_try_acquire(spinlock_t *lk)
 {
     return spinlock_try_acquire_A(lk);
 }
-#endif  /* !DEBUG_LOCKHOLDING */
+#endif  /* !(DEBUG_LOCKHOLDING || LOCKSTAT) */
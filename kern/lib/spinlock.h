@@ -7,14 +7,39 @@
 #include <lib/types.h>
 #include <lib/x86.h>
 
+/*
+ * Lock algorithms behind spinlock_t, selected per lock with
+ * spinlock_init_type(). spinlock_init() and zero-initialized locks use
+ * SPINLOCK_TAS.
+ */
+#define SPINLOCK_TAS    0  /* test-and-set on xchg, unfair */
+#define SPINLOCK_TICKET 1  /* FIFO ticket lock, waiters spin on one shared word */
+#define SPINLOCK_MCS    2  /* FIFO queue lock, each waiter spins on its own node */
+
+struct mcs_node {
+    struct mcs_node *volatile next;
+    volatile uint32_t locked;
+    uint32_t used;
+};
+
 typedef struct {
     uint32_t lock_holder;
-    volatile uint32_t lock;
+    volatile uint32_t lock;          // 1 while held (the lock word for TAS)
+    uint32_t type;
+    volatile uint32_t next;          // ticket: next ticket to hand out
+    volatile uint32_t owner;         // ticket: ticket being served
+    struct mcs_node *volatile tail;  // MCS: last node in the queue
+    struct mcs_node *node;           // MCS: node of the current holder
+#ifdef LOCKSTAT
+    void *stat_site;                 // lockstat entry of the acquiring call site
+    uint64_t stat_start;             // TSC when the lock was acquired
+#endif
 } spinlock_t;
 
 void spinlock_init(spinlock_t *lk);
+void spinlock_init_type(spinlock_t *lk, uint32_t type);
 
-#ifdef DEBUG_LOCKHOLDING
+#if defined(DEBUG_LOCKHOLDING) || defined(LOCKSTAT)
 #define spinlock_acquire(lk)     spinlock_acquire_(lk, __FILE__, __LINE__)
 #define spinlock_release(lk)     spinlock_release_(lk, __FILE__, __LINE__)
 #define spinlock_try_acquire(lk) spinlock_try_acquire_(lk, __FILE__, __LINE__)
@@ -22,11 +47,11 @@ void spinlock_init(spinlock_t *lk);
 void spinlock_acquire_(spinlock_t *lk, ...);
 void spinlock_release_(spinlock_t *lk, const char *file, int line);
 int spinlock_try_acquire_(spinlock_t *lk, const char *file, int line);
-#else   /* DEBUG_LOCKHOLDING */
+#else   /* DEBUG_LOCKHOLDING || LOCKSTAT */
 void spinlock_acquire(spinlock_t *lk);
 void spinlock_release(spinlock_t *lk);
 int spinlock_try_acquire(spinlock_t *lk);
-#endif  /* !DEBUG_LOCKHOLDING */
+#endif  /* !(DEBUG_LOCKHOLDING || LOCKSTAT) */
 
 bool spinlock_holding(spinlock_t *lk);
 
@@ -34,6 +34,10 @@ enum __syscall_nr {
     SYS_puts = 0,   /* output a string to the screen */
     SYS_spawn,      /* create a new process */
     SYS_yield,      /* yield to another process */
+    SYS_yield_to,   /* yield directly to a given process */
+    SYS_sched_deadline,  /* join or leave the deadline scheduling class */
+    SYS_dl_stat,         /* deadline misses and overruns of a process */
+    SYS_cpu_quota,       /* limit the CPU bandwidth of a child container */
     SYS_open,
     SYS_close,
     SYS_read,
@@ -49,6 +53,13 @@ enum __syscall_nr {
     SYS_pwd,
     SYS_readline,
 
+    SYS_shm_map,     /* map a shared page into the caller */
+    SYS_futex_wait,  /* sleep if a user word still holds a value */
+    SYS_futex_wake,  /* wake processes sleeping on a user word */
+    SYS_lockstat,    /* dump or reset the kernel lock statistics */
+    SYS_bufstat,     /* read or reset the buffer cache statistics */
+    SYS_logstat,     /* read or reset the log transaction statistics */
+
     MAX_SYSCALL_NR  /* XXX: always put it at the end of __syscall_nr */
 };
 
@@ -83,12 +94,37 @@ enum __error_nr {
     E_CREATE,        /* file does not exist */
     E_FNF,           /* file not found */
     E_BADF,          /* bad file descriptor */
+    E_AGAIN,         /* value changed, try again */
+    E_INVAL_ARG,     /* invalid argument */
     MAX_ERROR_NR     /* XXX: always put it at the end of __error_nr */
 };
 
 #define DISK_READ  0
 #define DISK_WRITE 1
 
+/* Buffer cache statistics returned by SYS_bufstat. */
+struct bufstat {
+    unsigned int hits;          /* lookups that found the block cached */
+    unsigned int misses;        /* lookups that recycled a buffer */
+    unsigned int probes;        /* hash chain entries examined */
+    unsigned int waits;         /* lookups that waited for a free buffer */
+    unsigned int meta_hits;     /* hits among the lookups of metadata */
+    unsigned int meta_misses;   /* misses among the lookups of metadata */
+    unsigned long long cycles;  /* spent finding or recycling buffers */
+    unsigned int nbuf;          /* buffers in the cache */
+    unsigned int npages;        /* pages holding their data and headers */
+};
+
+/* Log statistics returned by SYS_logstat. */
+struct logstat {
+    unsigned int ops;          /* system calls that joined a transaction */
+    unsigned int commits;      /* transactions committed with blocks to log */
+    unsigned int blocks;       /* blocks logged by those commits */
+    unsigned int waits;        /* system calls that waited for a full log */
+    unsigned int checkpoints;  /* times the journal space was reclaimed */
+    unsigned int capacity;     /* sectors a transaction may log */
+};
+
 typedef enum {
     GUEST_EAX, GUEST_EBX, GUEST_ECX, GUEST_EDX, GUEST_ESI, GUEST_EDI,
     GUEST_EBP, GUEST_ESP, GUEST_EIP, GUEST_EFLAGS,
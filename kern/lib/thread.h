@@ -5,6 +5,9 @@
 
 #define SCHED_SLICE 5
 
+// Upper bound (exclusive) on deadline class periods, in milliseconds.
+#define DL_MAX_PERIOD (1 << 20)
+
 typedef enum {
     TSTATE_READY = 0,
     TSTATE_RUN,
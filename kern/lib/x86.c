@@ -80,6 +80,16 @@ gcc_inline uint32_t cmpxchg(volatile uint32_t *addr, uint32_t oldval, uint32_t n
     return result;
 }
 
+gcc_inline uint32_t xadd(volatile uint32_t *addr, uint32_t incr)
+{
+    __asm __volatile ("lock; xaddl %0, %1"
+                      : "+r" (incr), "+m" (*addr)
+                      :
+                      : "memory", "cc");
+
+    return incr;
+}
+
 gcc_inline uint64_t rdtsc(void)
 {
     uint64_t rv;
@@ -178,6 +188,11 @@ gcc_inline void smp_wmb(void)
     __asm __volatile ("" ::: "memory");
 }
 
+gcc_inline void smp_rmb(void)
+{
+    __asm __volatile ("" ::: "memory");
+}
+
 gcc_inline void ltr(uint16_t sel)
 {
     __asm __volatile ("ltr %0" :: "r" (sel));
@@ -105,9 +105,8 @@
 
 /* other constants */
 #define NUM_CPUS 8
-#define NUM_IDS 64
+#define NUM_IDS 4096
 #define MagicNumber 1048577
-#define MAX_CHILDREN 3
 
 uintptr_t read_esp(void);
 uint32_t read_ebp(void);
@@ -120,6 +119,7 @@ void pause(void);
 void halt(void);
 uint32_t xchg(volatile uint32_t *addr, uint32_t newval);
 uint32_t cmpxchg(volatile uint32_t *addr, uint32_t oldval, uint32_t newval);
+uint32_t xadd(volatile uint32_t *addr, uint32_t incr);
 uint64_t rdtsc(void);
 void enable_sse(void);
 void cpuid(uint32_t info, uint32_t *eaxp, uint32_t *ebxp, uint32_t *ecxp,
@@ -131,6 +131,7 @@ uint32_t rcr3(void);
 void outl(int port, uint32_t data);
 uint32_t inl(int port);
 void smp_wmb(void);
+void smp_rmb(void);
 void ltr(uint16_t sel);
 void lcr0(uint32_t val);
 uint32_t rcr0(void);
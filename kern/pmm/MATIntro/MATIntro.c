@@ -33,7 +33,7 @@ struct ATStruct {
 static struct ATStruct AT[1 << 20];
 
 void mem_spinlock_init(void) {
-    spinlock_init(&mem_lk);
+    spinlock_init_type(&mem_lk, SPINLOCK_TICKET);
 }
 
 void mem_lock(void) {
@@ -1,5 +1,6 @@
 #include <lib/debug.h>
 #include <lib/spinlock.h>
+#include <lib/seqlock.h>
 #include <lib/x86.h>
 #include "import.h"
 
@@ -9,11 +10,35 @@ struct SContainer {
     int parent;     // the id of the parent process
     int nchildren;  // the number of child processes
     int used;       // whether current container is used by a process
+    unsigned int cpu_quota;   // ms of CPU time per cpu_period, 0 if unlimited
+    unsigned int cpu_period;  // length of the CPU accounting period in ms
+    unsigned int cpu_usage;   // ms of CPU time used in the current period
+    unsigned int cpu_start;   // start time of the current period
 };
 
 // mCertiKOS supports up to NUM_IDS processes
 static struct SContainer CONTAINER[NUM_IDS];
-static spinlock_t container_lks[NUM_IDS];
+
+/**
+ * Updates of a container hold its seqlock for writing. The accounting reads
+ * below (quota and usage checks, the CPU throttling test) retry instead of
+ * locking, so frequent readers do not contend with each other or with the
+ * page allocator.
+ */
+static seqlock_t container_lks[NUM_IDS];
+
+/**
+ * Container (process) ids are not tied to the position in the container tree.
+ * Unused ids are kept on a free list threaded through next_free_id, so that
+ * both allocating and releasing an id take constant time.
+ * NUM_IDS terminates the list.
+ * max_id is one past the largest id ever handed out, which bounds the scans
+ * over all processes done by the upper layers.
+ */
+static unsigned int next_free_id[NUM_IDS];
+static unsigned int free_id_head;
+static unsigned int max_id;
+static spinlock_t id_lk;
 
 /**
  * Initializes the container data for the root process (the one with index 0).
@@ -48,10 +73,25 @@ void container_init(unsigned int mbi_addr)
     CONTAINER[0].parent = 0;
     CONTAINER[0].nchildren = 0;
     CONTAINER[0].used = 1;
+    CONTAINER[0].cpu_quota = 0;
 
     for (idx = 0; idx < NUM_IDS; idx++) {
-        spinlock_init(&container_lks[idx]);
+        seqlock_init(&container_lks[idx]);
+    }
+
+    spinlock_init(&id_lk);
+    for (idx = 1; idx < NUM_IDS; idx++) {
+        next_free_id[idx] = idx + 1;
     }
+    next_free_id[NUM_IDS - 1] = NUM_IDS;
+    free_id_head = 1;
+    max_id = 1;
+}
+
+// Returns one past the largest container id that has ever been in use.
+unsigned int container_get_max_id(void)
+{
+    return max_id;
 }
 
 // Get the id of parent process of process # [id].
@@ -69,41 +109,70 @@ unsigned int container_get_nchildren(unsigned int id)
 // Get the maximum memory quota of process # [id].
 unsigned int container_get_quota(unsigned int id)
 {
-    return CONTAINER[id].quota;
+    unsigned int seq, quota;
+
+    do {
+        seq = seqlock_read_begin(&container_lks[id]);
+        quota = CONTAINER[id].quota;
+    } while (seqlock_read_retry(&container_lks[id], seq));
+
+    return quota;
 }
 
 // Get the current memory usage of process # [id].
 unsigned int container_get_usage(unsigned int id)
 {
-    return CONTAINER[id].usage;
+    unsigned int seq, usage;
+
+    do {
+        seq = seqlock_read_begin(&container_lks[id]);
+        usage = CONTAINER[id].usage;
+    } while (seqlock_read_retry(&container_lks[id], seq));
+
+    return usage;
 }
 
 // Determines whether the process # [id] can consume an extra
 // [n] pages of memory. If so, returns 1, otherwise, returns 0.
 unsigned int container_can_consume(unsigned int id, unsigned int n)
 {
-    return CONTAINER[id].usage + n <= CONTAINER[id].quota;
+    unsigned int seq, ok;
+
+    do {
+        seq = seqlock_read_begin(&container_lks[id]);
+        ok = CONTAINER[id].usage + n <= CONTAINER[id].quota;
+    } while (seqlock_read_retry(&container_lks[id], seq));
+
+    return ok;
 }
 
 /**
  * Dedicates [quota] pages of memory for a new child process.
  * You can assume it is safe to allocate [quota] pages
  * (the check is already done outside before calling this function).
- * Returns the container index for the new child process.
+ * Returns the container index for the new child process,
+ * or NUM_IDS if all the container indices are in use.
  */
 unsigned int container_split(unsigned int id, unsigned int quota)
 {
-    unsigned int child, nc;
-
-    spinlock_acquire(&container_lks[id]);
+    unsigned int child;
 
-    nc = CONTAINER[id].nchildren;
-    child = id * MAX_CHILDREN + 1 + nc;  // container index for the child process
+    spinlock_acquire(&id_lk);
+    child = free_id_head;
+    if (child != NUM_IDS) {
+        free_id_head = next_free_id[child];
+        if (max_id <= child) {
+            max_id = child + 1;
+        }
+    }
+    spinlock_release(&id_lk);
 
-    if (NUM_IDS <= child) {
+    if (child == NUM_IDS) {
         return NUM_IDS;
     }
 
+    seqlock_write_begin(&container_lks[id]);
+
     /**
      * Update the container structure of both parent and child process appropriately.
      */
@@ -112,15 +181,134 @@ unsigned int container_split(unsigned int id, unsigned int quota)
     CONTAINER[child].usage = 0;
     CONTAINER[child].parent = id;
     CONTAINER[child].nchildren = 0;
+    CONTAINER[child].cpu_quota = 0;
 
     CONTAINER[id].usage += quota;
     CONTAINER[id].nchildren++;
 
-    spinlock_release(&container_lks[id]);
+    seqlock_write_end(&container_lks[id]);
 
     return child;
 }
 
+/**
+ * Reverse operation of container_split.
+ * Returns the quota of the container # [id] to its parent and puts the
+ * container index back on the free list.
+ * All the pages of the container should have been freed already.
+ */
+void container_merge(unsigned int id)
+{
+    unsigned int parent = CONTAINER[id].parent;
+
+    seqlock_write_begin(&container_lks[parent]);
+    CONTAINER[parent].usage -= CONTAINER[id].quota;
+    CONTAINER[parent].nchildren--;
+    seqlock_write_end(&container_lks[parent]);
+
+    seqlock_write_begin(&container_lks[id]);
+    CONTAINER[id].used = 0;
+    CONTAINER[id].quota = 0;
+    CONTAINER[id].usage = 0;
+    seqlock_write_end(&container_lks[id]);
+
+    spinlock_acquire(&id_lk);
+    next_free_id[id] = free_id_head;
+    free_id_head = id;
+    spinlock_release(&id_lk);
+}
+
+/**
+ * CPU bandwidth control.
+ * A container with a CPU quota may use at most cpu_quota ms of CPU time in
+ * every cpu_period ms, counting the time of all its descendants, which are
+ * charged through the same parent links as the memory quota.
+ * A container is throttled while it or any of its ancestors has used up its
+ * quota for the current period. The times are given by the caller.
+ */
+
+// Starts a new period for container # [id] if the current one has ended.
+static void container_cpu_roll(unsigned int id, unsigned int now)
+{
+    struct SContainer *c = &CONTAINER[id];
+
+    if (c->cpu_quota != 0 && now - c->cpu_start >= c->cpu_period) {
+        c->cpu_start = now - (now - c->cpu_start) % c->cpu_period;
+        c->cpu_usage = 0;
+    }
+}
+
+/**
+ * Limits container # [id] and its descendants to [quota] ms of CPU time in
+ * every [period] ms, starting at time [now]. A quota of 0 removes the limit.
+ */
+void container_set_cpu(unsigned int id, unsigned int quota, unsigned int period,
+                       unsigned int now)
+{
+    seqlock_write_begin(&container_lks[id]);
+    CONTAINER[id].cpu_quota = quota;
+    CONTAINER[id].cpu_period = period;
+    CONTAINER[id].cpu_usage = 0;
+    CONTAINER[id].cpu_start = now;
+    seqlock_write_end(&container_lks[id]);
+}
+
+/**
+ * Charges [ms] of CPU time to container # [id] and all its ancestors.
+ * Returns 1 if this leaves the container throttled, 0 otherwise.
+ */
+unsigned int container_charge_cpu(unsigned int id, unsigned int now, unsigned int ms)
+{
+    unsigned int throttled = 0;
+
+    while (1) {
+        seqlock_write_begin(&container_lks[id]);
+        container_cpu_roll(id, now);
+        if (CONTAINER[id].cpu_quota != 0) {
+            CONTAINER[id].cpu_usage += ms;
+            if (CONTAINER[id].cpu_usage >= CONTAINER[id].cpu_quota) {
+                throttled = 1;
+            }
+        }
+        seqlock_write_end(&container_lks[id]);
+
+        if (id == 0) {
+            break;
+        }
+        id = CONTAINER[id].parent;
+    }
+
+    return throttled;
+}
+
+/**
+ * Returns 1 if container # [id] may not use the CPU until its next period.
+ * A period that has already ended counts as rolled over, so this only reads.
+ */
+unsigned int container_cpu_throttled(unsigned int id, unsigned int now)
+{
+    unsigned int seq, throttled;
+    struct SContainer *c;
+
+    while (1) {
+        c = &CONTAINER[id];
+        do {
+            seq = seqlock_read_begin(&container_lks[id]);
+            throttled = c->cpu_quota != 0
+                && now - c->cpu_start < c->cpu_period
+                && c->cpu_usage >= c->cpu_quota;
+        } while (seqlock_read_retry(&container_lks[id], seq));
+
+        if (throttled) {
+            return 1;
+        }
+        if (id == 0) {
+            return 0;
+        }
+        id = CONTAINER[id].parent;
+    }
+}
+
 /**
  * Allocates one more page for process # [id], given that this will not exceed the quota.
  * The container structure should be updated accordingly after the allocation.
@@ -130,14 +318,14 @@ unsigned int container_alloc(unsigned int id)
 {
     unsigned int page_index = 0;
 
-    spinlock_acquire(&container_lks[id]);
+    seqlock_write_begin(&container_lks[id]);
 
     if (CONTAINER[id].usage + 1 <= CONTAINER[id].quota) {
         CONTAINER[id].usage++;
         page_index = palloc();
     }
 
-    spinlock_release(&container_lks[id]);
+    seqlock_write_end(&container_lks[id]);
 
     return page_index;
 }
@@ -145,7 +333,7 @@ unsigned int container_alloc(unsigned int id)
 // Frees the physical page and reduces the usage by 1.
 void container_free(unsigned int id, unsigned int page_index)
 {
-    spinlock_acquire(&container_lks[id]);
+    seqlock_write_begin(&container_lks[id]);
 
     if (at_is_allocated(page_index)) {
         pfree(page_index);
@@ -154,5 +342,5 @@ void container_free(unsigned int id, unsigned int page_index)
         }
     }
 
-    spinlock_release(&container_lks[id]);
+    seqlock_write_end(&container_lks[id]);
 }
@@ -10,6 +10,12 @@ unsigned int container_get_quota(unsigned int id);
 unsigned int container_get_usage(unsigned int id);
 unsigned int container_can_consume(unsigned int id, unsigned int n);
 unsigned int container_split(unsigned int id, unsigned int quota);
+void container_merge(unsigned int id);
+unsigned int container_get_max_id(void);
+void container_set_cpu(unsigned int id, unsigned int quota, unsigned int period,
+                       unsigned int now);
+unsigned int container_charge_cpu(unsigned int id, unsigned int now, unsigned int ms);
+unsigned int container_cpu_throttled(unsigned int id, unsigned int now);
 unsigned int container_alloc(unsigned int id);
 void container_free(unsigned int id, unsigned int page_index);
 
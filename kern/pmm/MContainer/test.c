@@ -50,6 +50,49 @@ int MContainer_test2()
     return 0;
 }
 
+int MContainer_test3()
+{
+    unsigned int old_usage = container_get_usage(0);
+    unsigned int old_nchildren = container_get_nchildren(0);
+    unsigned int chid = container_split(0, 100);
+    container_merge(chid);
+    if (container_get_usage(0) != old_usage
+        || container_get_nchildren(0) != old_nchildren) {
+        dprintf("test 3.1 failed: (%d != %d || %d != %d)\n",
+                container_get_usage(0), old_usage,
+                container_get_nchildren(0), old_nchildren);
+        return 1;
+    }
+    if (container_split(0, 100) != chid) {
+        dprintf("test 3.2 failed: the released id %d is not reused\n", chid);
+        return 1;
+    }
+    container_merge(chid);
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int MContainer_test4()
+{
+    unsigned int chid = container_split(0, 100);
+    unsigned int grandchild = container_split(chid, 10);
+    container_set_cpu(chid, 10, 50, 1000);
+    if (container_charge_cpu(grandchild, 1005, 9) != 0
+        || container_charge_cpu(grandchild, 1006, 1) != 1
+        || container_cpu_throttled(chid, 1040) != 1) {
+        dprintf("test 4.1 failed: the parent quota is not charged\n");
+        return 1;
+    }
+    if (container_cpu_throttled(grandchild, 1050) != 0) {
+        dprintf("test 4.2 failed: still throttled in the next period\n");
+        return 1;
+    }
+    container_merge(grandchild);
+    container_merge(chid);
+    dprintf("test 4 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -72,5 +115,6 @@ int MContainer_test_own()
 
 int test_MContainer()
 {
-    return MContainer_test1() + MContainer_test2() + MContainer_test_own();
+    return MContainer_test1() + MContainer_test2() + MContainer_test3()
+           + MContainer_test4() + MContainer_test_own();
 }
@@ -1,6 +1,7 @@
 #include <lib/x86.h>
 #include <lib/thread.h>
 #include <lib/spinlock.h>
+#include <lib/mutex.h>
 #include <lib/debug.h>
 #include <dev/lapic.h>
 #include <pcpu/PCPUIntro/export.h>
@@ -12,6 +13,56 @@ static spinlock_t sched_lk;
 
 unsigned int sched_ticks[NUM_CPUS];
 
+/**
+ * Deadline scheduling class.
+ * A thread in this class declares a runtime, a period and a relative deadline
+ * (all in milliseconds). At the start of every period it gets [runtime] ms of
+ * budget and a new absolute deadline; ready deadline threads always run
+ * before the normal ready queue, earliest absolute deadline first.
+ * Deadline threads are never put on the normal ready queue.
+ * A thread that exhausts its budget is throttled until its next period, and
+ * a thread that yields is done with the current job and waits likewise.
+ */
+struct sched_dl {
+    unsigned int runtime;
+    unsigned int period;        // 0 if the thread is not in the deadline class
+    unsigned int deadline;
+    unsigned int bw;            // runtime / deadline, scaled by 1 << DL_BW_SHIFT
+    unsigned int remaining;     // budget left in the current period
+    unsigned int abs_deadline;  // deadline of the current job
+    unsigned int next_release;  // start of the next period
+    unsigned int throttled;     // no budget or job done until next_release
+    unsigned int active;        // the current job has not completed yet
+    unsigned int missed;        // the current job is already counted as a miss
+    unsigned int nr_misses;
+    unsigned int nr_overruns;
+};
+
+#define DL_MAX_TASKS 16
+#define DL_BW_SHIFT  10
+// Leave 5% of the CPU to the normal ready queue.
+#define DL_BW_LIMIT  ((95 << DL_BW_SHIFT) / 100)
+
+static struct sched_dl sched_dl[NUM_IDS];
+static unsigned int dl_pids[DL_MAX_TASKS];
+static unsigned int nr_dl;
+static unsigned int dl_total_bw;
+
+// Milliseconds since the scheduler started, advanced by the timer of CPU 0.
+static unsigned int sched_clock;
+
+/**
+ * Threads in thread_sleep_timeout, woken up by sched_update at timed_wake
+ * unless a thread_wakeup on their channel comes first.
+ */
+#define MAX_TIMED 16
+
+static unsigned int timed_pids[MAX_TIMED];
+static unsigned int timed_wake[MAX_TIMED];
+static unsigned int nr_timed;
+
+#define TIME_BEFORE(a, b) ((int) ((a) - (b)) < 0)
+
 void thread_init(unsigned int mbi_addr)
 {
     unsigned int i;
@@ -19,12 +70,105 @@ void thread_init(unsigned int mbi_addr)
         sched_ticks[i] = 0;
     }
 
-    spinlock_init(&sched_lk);
+    nr_dl = 0;
+    dl_total_bw = 0;
+    sched_clock = 0;
+    nr_timed = 0;
+
+    spinlock_init_type(&sched_lk, SPINLOCK_MCS);
     tqueue_init(mbi_addr);
     set_curid(0);
     tcb_set_state(0, TSTATE_RUN);
 }
 
+/**
+ * Puts a ready thread where the scheduler will find it.
+ * Deadline threads are picked from dl_pids, not from the ready queue.
+ * Must be called with sched_lk held.
+ */
+static void sched_enqueue(unsigned int pid)
+{
+    if (sched_dl[pid].period == 0) {
+        tqueue_enqueue(NUM_IDS, pid);
+    }
+}
+
+/**
+ * Picks the ready, unthrottled deadline thread with the earliest absolute
+ * deadline, or NUM_IDS if there is none.
+ * Must be called with sched_lk held.
+ */
+static unsigned int sched_pick_dl(void)
+{
+    unsigned int i, pid, best = NUM_IDS;
+
+    for (i = 0; i < nr_dl; i++) {
+        pid = dl_pids[i];
+        if (tcb_get_state(pid) != TSTATE_READY || sched_dl[pid].throttled) {
+            continue;
+        }
+        if (best == NUM_IDS
+            || TIME_BEFORE(sched_dl[pid].abs_deadline, sched_dl[best].abs_deadline)) {
+            best = pid;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Chooses the next thread to run and removes it from the ready queue.
+ * Threads whose container is out of CPU quota are rotated to the tail of
+ * the ready queue; if every ready thread is throttled, the first one runs.
+ * Must be called with sched_lk held.
+ */
+static unsigned int sched_pick_next(void)
+{
+    unsigned int pid = sched_pick_dl();
+    unsigned int first = NUM_IDS;
+
+    if (pid != NUM_IDS) {
+        return pid;
+    }
+
+    while ((pid = tqueue_dequeue(NUM_IDS)) != NUM_IDS) {
+        if (pid == first || !container_cpu_throttled(pid, sched_clock)) {
+            break;
+        }
+        if (first == NUM_IDS) {
+            first = pid;
+        }
+        tqueue_enqueue(NUM_IDS, pid);
+    }
+    return pid;
+}
+
+/**
+ * Puts the running thread back as ready and switches to the next one.
+ * Must be called with sched_lk held; releases it.
+ */
+static void sched_switch(void)
+{
+    unsigned int old_cur_pid;
+    unsigned int new_cur_pid;
+
+    old_cur_pid = get_curid();
+    tcb_set_state(old_cur_pid, TSTATE_READY);
+    sched_enqueue(old_cur_pid);
+
+    new_cur_pid = sched_pick_next();
+    tcb_set_state(new_cur_pid, TSTATE_RUN);
+    set_curid(new_cur_pid);
+
+    if (old_cur_pid != new_cur_pid) {
+        spinlock_release(&sched_lk);
+        kctx_switch(old_cur_pid, new_cur_pid);
+    }
+    else {
+        spinlock_release(&sched_lk);
+    }
+}
+
 /**
  * Allocates a new child thread context, sets the state of the new child thread
  * to ready, and pushes it to the ready queue.
@@ -39,7 +183,7 @@ unsigned int thread_spawn(void *entry, unsigned int id, unsigned int quota)
     pid = kctx_new(entry, id, quota);
     if (pid != NUM_IDS) {
         tcb_set_state(pid, TSTATE_READY);
-        tqueue_enqueue(NUM_IDS, pid);
+        sched_enqueue(pid);
     }
 
     spinlock_release(&sched_lk);
@@ -55,45 +199,240 @@ unsigned int thread_spawn(void *entry, unsigned int id, unsigned int quota)
  * current thread id, and switch to the new kernel context.
  * Hint: If you are the only thread that is ready to run,
  * do you need to switch to yourself?
+ * A deadline thread that yields has completed its current job, and is
+ * throttled until its next period.
  */
 void thread_yield(void)
+{
+    unsigned int cur = get_curid();
+
+    spinlock_acquire(&sched_lk);
+
+    if (sched_dl[cur].period != 0) {
+        sched_dl[cur].active = 0;
+        sched_dl[cur].throttled = 1;
+    }
+    sched_switch();
+}
+
+/**
+ * Directed yield: if process # [pid] is ready and not throttled, switch
+ * straight to it instead
+ * of the head of the ready queue, and put the current thread back at the
+ * tail of the queue. The tick count of this CPU is left untouched, so the
+ * target runs for the rest of the caller's time slice. A deadline thread
+ * that hands off the CPU completes its current job, as in thread_yield.
+ * Returns 1 if the switch happened, 0 if the target was not ready.
+ */
+unsigned int thread_yield_to(unsigned int pid)
 {
     unsigned int old_cur_pid;
-    unsigned int new_cur_pid;
 
     spinlock_acquire(&sched_lk);
 
     old_cur_pid = get_curid();
+    if (pid >= NUM_IDS || pid == old_cur_pid
+        || tcb_get_state(pid) != TSTATE_READY
+        || container_cpu_throttled(pid, sched_clock)
+        || (sched_dl[pid].period != 0 && sched_dl[pid].throttled)) {
+        spinlock_release(&sched_lk);
+        return 0;
+    }
+
+    if (sched_dl[pid].period == 0) {
+        tqueue_remove(NUM_IDS, pid);
+    }
+    if (sched_dl[old_cur_pid].period != 0) {
+        sched_dl[old_cur_pid].active = 0;
+        sched_dl[old_cur_pid].throttled = 1;
+    }
     tcb_set_state(old_cur_pid, TSTATE_READY);
-    tqueue_enqueue(NUM_IDS, old_cur_pid);
+    sched_enqueue(old_cur_pid);
 
-    new_cur_pid = tqueue_dequeue(NUM_IDS);
-    tcb_set_state(new_cur_pid, TSTATE_RUN);
-    set_curid(new_cur_pid);
+    tcb_set_state(pid, TSTATE_RUN);
+    set_curid(pid);
 
-    if (old_cur_pid != new_cur_pid) {
-        spinlock_release(&sched_lk);
-        kctx_switch(old_cur_pid, new_cur_pid);
+    spinlock_release(&sched_lk);
+    kctx_switch(old_cur_pid, pid);
+
+    return 1;
+}
+
+/**
+ * Charges one timer tick to the deadline thread [cur], starts new periods,
+ * and counts deadline misses.
+ * Returns 1 if the running thread should be preempted.
+ * Must be called with sched_lk held.
+ */
+static unsigned int sched_dl_tick(unsigned int cur, unsigned int tick)
+{
+    struct sched_dl *dl;
+    unsigned int i, resched = 0;
+
+    dl = &sched_dl[cur];
+    if (dl->period != 0 && !dl->throttled) {
+        dl->remaining = dl->remaining > tick ? dl->remaining - tick : 0;
+        if (dl->remaining == 0) {
+            dl->throttled = 1;
+            dl->nr_overruns++;
+            resched = 1;
+        }
     }
-    else {
-        spinlock_release(&sched_lk);
+
+    for (i = 0; i < nr_dl; i++) {
+        dl = &sched_dl[dl_pids[i]];
+        if (dl->active && !dl->missed && !TIME_BEFORE(sched_clock, dl->abs_deadline)) {
+            dl->missed = 1;
+            dl->nr_misses++;
+        }
+        if (!TIME_BEFORE(sched_clock, dl->next_release)) {
+            dl->remaining = dl->runtime;
+            dl->abs_deadline = dl->next_release + dl->deadline;
+            dl->next_release += dl->period;
+            dl->throttled = 0;
+            dl->active = 1;
+            dl->missed = 0;
+            if (dl_pids[i] != cur) {
+                resched = 1;
+            }
+        }
+    }
+
+    return resched;
+}
+
+/**
+ * Wakes up the timed sleepers whose timeout has expired.
+ * Must be called with sched_lk held.
+ */
+static void sched_timed_tick(void)
+{
+    unsigned int i = 0, pid;
+
+    while (i < nr_timed) {
+        if (TIME_BEFORE(sched_clock, timed_wake[i])) {
+            i++;
+            continue;
+        }
+        pid = timed_pids[i];
+        if (tcb_get_state(pid) == TSTATE_SLEEP) {
+            tcb_set_state(pid, TSTATE_READY);
+            tcb_set_chan(pid, 0);
+            sched_enqueue(pid);
+        }
+        nr_timed--;
+        timed_pids[i] = timed_pids[nr_timed];
+        timed_wake[i] = timed_wake[nr_timed];
     }
 }
 
 void sched_update(void)
 {
+    unsigned int cpu_idx = get_pcpu_idx();
+    unsigned int tick = 1000 / LAPIC_TIMER_INTR_FREQ;
+    unsigned int resched;
+
     spinlock_acquire(&sched_lk);
-    sched_ticks[get_pcpu_idx()] += 1000 / LAPIC_TIMER_INTR_FREQ;
-    if (sched_ticks[get_pcpu_idx()] >= SCHED_SLICE) {
-        sched_ticks[get_pcpu_idx()] = 0;
-        spinlock_release(&sched_lk);
-        thread_yield();
+    sched_ticks[cpu_idx] += tick;
+    if (cpu_idx == 0) {
+        sched_clock += tick;
+        sched_timed_tick();
+    }
+
+    resched = sched_dl_tick(get_curid(), tick);
+    if (container_charge_cpu(get_curid(), sched_clock, tick)) {
+        resched = 1;
+    }
+    if (sched_ticks[cpu_idx] >= SCHED_SLICE) {
+        sched_ticks[cpu_idx] = 0;
+        resched = 1;
+    }
+
+    if (resched) {
+        sched_switch();
     }
     else {
         spinlock_release(&sched_lk);
     }
 }
 
+/**
+ * Moves process # [pid] into the deadline class with the given parameters
+ * in milliseconds, or back to the normal class if [period] is 0.
+ * The caller validates 0 < runtime <= deadline <= period < DL_MAX_PERIOD.
+ * Admission control keeps the total density (runtime / deadline) of all
+ * deadline threads below DL_BW_LIMIT, which guarantees EDF meets every
+ * deadline on one CPU. Returns 1 on success, 0 if the request is refused.
+ * Only the running thread changes its own class, so it is never queued.
+ */
+unsigned int thread_set_deadline(unsigned int pid, unsigned int runtime,
+                                 unsigned int period, unsigned int deadline)
+{
+    struct sched_dl *dl = &sched_dl[pid];
+    unsigned int i, bw = 0;
+
+    if (period != 0) {
+        bw = (runtime << DL_BW_SHIFT) / deadline;
+    }
+
+    spinlock_acquire(&sched_lk);
+
+    if (period != 0
+        && (dl_total_bw - dl->bw + bw > DL_BW_LIMIT
+            || (dl->period == 0 && nr_dl == DL_MAX_TASKS))) {
+        spinlock_release(&sched_lk);
+        return 0;
+    }
+
+    if (dl->period != 0) {
+        for (i = 0; dl_pids[i] != pid; i++);
+        dl_pids[i] = dl_pids[--nr_dl];
+    }
+    dl_total_bw = dl_total_bw - dl->bw + bw;
+
+    dl->runtime = runtime;
+    dl->period = period;
+    dl->deadline = deadline;
+    dl->bw = bw;
+    if (period != 0) {
+        dl->remaining = runtime;
+        dl->abs_deadline = sched_clock + deadline;
+        dl->next_release = sched_clock + period;
+        dl->throttled = 0;
+        dl->active = 1;
+        dl->missed = 0;
+        dl_pids[nr_dl++] = pid;
+    }
+
+    spinlock_release(&sched_lk);
+
+    return 1;
+}
+
+/**
+ * Limits the CPU time of process # [pid] and its descendants to [quota] ms
+ * in every [period] ms, or lifts the limit if [quota] is 0.
+ * The limit is enforced by charging every timer tick in sched_update.
+ */
+void thread_set_cpu_quota(unsigned int pid, unsigned int quota, unsigned int period)
+{
+    spinlock_acquire(&sched_lk);
+    container_set_cpu(pid, quota, period, sched_clock);
+    spinlock_release(&sched_lk);
+}
+
+// Number of deadline misses of process # [pid].
+unsigned int thread_get_dl_misses(unsigned int pid)
+{
+    return sched_dl[pid].nr_misses;
+}
+
+// Number of times process # [pid] ran out of budget and got throttled.
+unsigned int thread_get_dl_overruns(unsigned int pid)
+{
+    return sched_dl[pid].nr_overruns;
+}
+
 /**
  * Atomically release lock and sleep on chan.
  * Reacquires lock when awakened.
@@ -121,7 +460,7 @@ void thread_sleep(void *chan, spinlock_t *lk)
     tcb_set_chan(curid, chan);
     
     // TODO: Context switch.
-    new_pid = tqueue_dequeue(NUM_IDS);
+    new_pid = sched_pick_next();
     tcb_set_state(new_pid, TSTATE_RUN);
     set_curid(new_pid);
     spinlock_release(&sched_lk);
@@ -135,6 +474,51 @@ void thread_sleep(void *chan, spinlock_t *lk)
     spinlock_acquire(lk);
 }
 
+/**
+ * Like thread_sleep, but also wakes up after [ms] milliseconds.
+ * At most MAX_TIMED threads may be in a timed sleep at once.
+ */
+void thread_sleep_timeout(void *chan, spinlock_t *lk, unsigned int ms)
+{
+    unsigned int curid = get_curid();
+    unsigned int new_pid, i;
+
+    if (lk == 0)
+        KERN_PANIC("sleep without lock");
+
+    spinlock_acquire(&sched_lk);
+    spinlock_release(lk);
+
+    if (nr_timed == MAX_TIMED)
+        KERN_PANIC("thread_sleep_timeout: too many timed sleepers");
+    timed_pids[nr_timed] = curid;
+    timed_wake[nr_timed] = sched_clock + ms;
+    nr_timed++;
+
+    tcb_set_state(curid, TSTATE_SLEEP);
+    tcb_set_chan(curid, chan);
+
+    new_pid = sched_pick_next();
+    tcb_set_state(new_pid, TSTATE_RUN);
+    set_curid(new_pid);
+    spinlock_release(&sched_lk);
+    kctx_switch(curid, new_pid);
+
+    // Drop the timeout if thread_wakeup came first.
+    spinlock_acquire(&sched_lk);
+    tcb_set_chan(curid, 0);
+    for (i = 0; i < nr_timed; i++) {
+        if (timed_pids[i] == curid) {
+            nr_timed--;
+            timed_pids[i] = timed_pids[nr_timed];
+            timed_wake[i] = timed_wake[nr_timed];
+            break;
+        }
+    }
+    spinlock_release(&sched_lk);
+    spinlock_acquire(lk);
+}
+
 /**
  * Wake up all processes sleeping on chan.
  */
@@ -142,13 +526,163 @@ void thread_wakeup(void *chan)
 {
     //TODO
     spinlock_acquire(&sched_lk);
-    unsigned int pid;
-    for (pid = 1; pid < NUM_IDS; ++pid) {
+    unsigned int pid, nids = container_get_max_id();
+    for (pid = 1; pid < nids; ++pid) {
       if (tcb_get_chan(pid) == chan && tcb_get_state(pid) == TSTATE_SLEEP) {
         tcb_set_state(pid, TSTATE_READY);
         tcb_set_chan(pid, 0);
-        tqueue_enqueue(NUM_IDS, pid);
+        sched_enqueue(pid);
       }
     }
     spinlock_release(&sched_lk);
 }
+
+/**
+ * Wake up at most n processes sleeping on chan, lowest pid first.
+ * Returns the number of processes actually woken up.
+ */
+unsigned int thread_wakeup_n(void *chan, unsigned int n)
+{
+    unsigned int pid, nids, woken;
+
+    spinlock_acquire(&sched_lk);
+    nids = container_get_max_id();
+    woken = 0;
+    for (pid = 1; pid < nids && woken < n; ++pid) {
+        if (tcb_get_chan(pid) == chan && tcb_get_state(pid) == TSTATE_SLEEP) {
+            tcb_set_state(pid, TSTATE_READY);
+            tcb_set_chan(pid, 0);
+            sched_enqueue(pid);
+            woken++;
+        }
+    }
+    spinlock_release(&sched_lk);
+
+    return woken;
+}
+
+/**
+ * Sleeping mutexes.
+ * Waiters sleep on the mutex itself and are linked through mutex_next, one
+ * link per thread since a thread waits for at most one mutex at a time.
+ */
+static unsigned int mutex_next[NUM_IDS];
+
+// Pause iterations a locker may spin while the holder runs on another CPU.
+#define MUTEX_SPIN_LIMIT 2000
+
+void mutex_init(mutex_t *m)
+{
+    spinlock_init(&m->lk);
+    m->locked = 0;
+    m->owner = NUM_IDS;
+    m->head = NUM_IDS;
+    m->tail = NUM_IDS;
+}
+
+/**
+ * Wakes up thread # [pid] if it is sleeping on chan.
+ */
+static void thread_wakeup_pid(void *chan, unsigned int pid)
+{
+    spinlock_acquire(&sched_lk);
+    if (tcb_get_chan(pid) == chan && tcb_get_state(pid) == TSTATE_SLEEP) {
+        tcb_set_state(pid, TSTATE_READY);
+        tcb_set_chan(pid, 0);
+        sched_enqueue(pid);
+    }
+    spinlock_release(&sched_lk);
+}
+
+/**
+ * Spins while the holder of m is running on another CPU, which likely means
+ * it will unlock soon, for at most MUTEX_SPIN_LIMIT iterations.
+ */
+static void mutex_spin(mutex_t *m)
+{
+    unsigned int i, owner, cpu = get_pcpu_idx();
+
+    for (i = 0; i < MUTEX_SPIN_LIMIT && m->locked; i++) {
+        owner = m->owner;
+        if (owner >= NUM_IDS || tcb_get_state(owner) != TSTATE_RUN
+            || tcb_get_cpu(owner) == cpu) {
+            return;
+        }
+        pause();
+    }
+}
+
+void mutex_lock(mutex_t *m)
+{
+    unsigned int curid = get_curid();
+
+    if (m->locked == 0 && cmpxchg(&m->locked, 0, 1) == 0) {
+        m->owner = curid;
+        return;
+    }
+
+    mutex_spin(m);
+
+    spinlock_acquire(&m->lk);
+    if (cmpxchg(&m->locked, 0, 1) == 0) {
+        m->owner = curid;
+        spinlock_release(&m->lk);
+        return;
+    }
+
+    // Queue up; mutex_unlock makes us the owner before waking us.
+    mutex_next[curid] = NUM_IDS;
+    if (m->head == NUM_IDS) {
+        m->head = curid;
+    } else {
+        mutex_next[m->tail] = curid;
+    }
+    m->tail = curid;
+
+    while (m->owner != curid) {
+        thread_sleep(m, &m->lk);
+    }
+    spinlock_release(&m->lk);
+}
+
+/**
+ * Returns 1 and takes m if it is free, returns 0 otherwise.
+ */
+unsigned int mutex_trylock(mutex_t *m)
+{
+    if (m->locked == 0 && cmpxchg(&m->locked, 0, 1) == 0) {
+        m->owner = get_curid();
+        return 1;
+    }
+    return 0;
+}
+
+unsigned int mutex_holding(mutex_t *m)
+{
+    return m->locked && m->owner == get_curid();
+}
+
+void mutex_unlock(mutex_t *m)
+{
+    unsigned int next;
+
+    if (!mutex_holding(m)) {
+        KERN_PANIC("mutex_unlock: not the holder");
+    }
+
+    spinlock_acquire(&m->lk);
+    next = m->head;
+    if (next == NUM_IDS) {
+        m->owner = NUM_IDS;
+        xchg(&m->locked, 0);
+    } else {
+        // Hand the mutex over without unlocking it, so nobody can barge in.
+        m->head = mutex_next[next];
+        if (m->head == NUM_IDS) {
+            m->tail = NUM_IDS;
+        }
+        m->owner = next;
+        thread_wakeup_pid(m, next);
+    }
+    spinlock_release(&m->lk);
+}
@@ -4,14 +4,29 @@
 #ifdef _KERN_
 
 #include <kern/lib/spinlock.h>
+#include <kern/lib/mutex.h>
 
 void thread_init(unsigned int mbi_addr);
 unsigned int thread_spawn(void *entry, unsigned int id,
                           unsigned int quota);
 void thread_yield(void);
+unsigned int thread_yield_to(unsigned int pid);
+unsigned int thread_set_deadline(unsigned int pid, unsigned int runtime,
+                                 unsigned int period, unsigned int deadline);
+void thread_set_cpu_quota(unsigned int pid, unsigned int quota, unsigned int period);
+unsigned int thread_get_dl_misses(unsigned int pid);
+unsigned int thread_get_dl_overruns(unsigned int pid);
 void sched_update(void);
 void thread_sleep(void *chan, spinlock_t *lk);
+void thread_sleep_timeout(void *chan, spinlock_t *lk, unsigned int ms);
 void thread_wakeup(void *chan);
+unsigned int thread_wakeup_n(void *chan, unsigned int n);
+
+void mutex_init(mutex_t *m);
+void mutex_lock(mutex_t *m);
+unsigned int mutex_trylock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+unsigned int mutex_holding(mutex_t *m);
 
 #endif  /* _KERN_ */
 
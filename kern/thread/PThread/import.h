@@ -11,12 +11,19 @@ void tcb_set_state(unsigned int pid, unsigned int state);
 void tqueue_init(unsigned int mbi_addr);
 void tqueue_enqueue(unsigned int chid, unsigned int pid);
 unsigned int tqueue_dequeue(unsigned int chid);
+void tqueue_remove(unsigned int chid, unsigned int pid);
 
 unsigned int get_curid(void);
 void set_curid(unsigned int curid);
 
 void tcb_set_cpu(unsigned int pid, unsigned int cpu);
 
+unsigned int container_get_max_id(void);
+void container_set_cpu(unsigned int id, unsigned int quota, unsigned int period,
+                       unsigned int now);
+unsigned int container_charge_cpu(unsigned int id, unsigned int now, unsigned int ms);
+unsigned int container_cpu_throttled(unsigned int id, unsigned int now);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_THREAD_PTHREAD_H_ */
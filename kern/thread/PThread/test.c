@@ -23,6 +23,26 @@ int PThread_test1()
     return 0;
 }
 
+int PThread_test2()
+{
+    mutex_t m;
+
+    mutex_init(&m);
+    mutex_lock(&m);
+    if (!mutex_holding(&m) || mutex_trylock(&m)) {
+        dprintf("test 2.1 failed: mutex not held after mutex_lock\n");
+        return 1;
+    }
+    mutex_unlock(&m);
+    if (mutex_holding(&m) || !mutex_trylock(&m)) {
+        dprintf("test 2.2 failed: mutex still held after mutex_unlock\n");
+        return 1;
+    }
+    mutex_unlock(&m);
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -45,5 +65,5 @@ int PThread_test_own()
 
 int test_PThread()
 {
-    return PThread_test1() + PThread_test_own();
+    return PThread_test1() + PThread_test2() + PThread_test_own();
 }
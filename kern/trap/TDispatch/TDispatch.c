@@ -62,6 +62,138 @@ void syscall_dispatch(tf_t *tf)
          */
         sys_yield(tf);
         break;
+    case SYS_yield_to:
+        /*
+         * Called by a process to hand its CPU slice to another process.
+         * Falls back to an ordinary yield if the target is not ready.
+         *
+         * Parameters:
+         *   a[0]: the process id of the target
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_PID: the process id is out of range.
+         */
+        sys_yield_to(tf);
+        break;
+    case SYS_sched_deadline:
+        /*
+         * Called by a process to join or leave the deadline scheduling class.
+         *
+         * Parameters:
+         *   a[0]: the runtime per period in milliseconds
+         *   a[1]: the period in milliseconds, 0 to leave the class
+         *   a[2]: the relative deadline in milliseconds
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_ARG: runtime <= deadline <= period does not hold.
+         *   E_EXCEEDS_QUOTA: admission control refused the request.
+         */
+        sys_sched_deadline(tf);
+        break;
+    case SYS_dl_stat:
+        /*
+         * Called by a process to read the deadline statistics of a process.
+         *
+         * Parameters:
+         *   a[0]: the process id
+         *
+         * Return:
+         *   a[0]: the number of deadline misses
+         *   a[1]: the number of budget overruns
+         *
+         * Error:
+         *   E_INVAL_PID: the process id is out of range.
+         */
+        sys_dl_stat(tf);
+        break;
+    case SYS_cpu_quota:
+        /*
+         * Called by a process to limit the CPU bandwidth of one of its
+         * children, including all the descendants of the child.
+         *
+         * Parameters:
+         *   a[0]: the process id of the child
+         *   a[1]: the CPU time in milliseconds allowed per period, 0 for no limit
+         *   a[2]: the period in milliseconds
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_CHILD_ID: the process is not a child of the caller.
+         *   E_INVAL_ARG: the quota is larger than the period.
+         */
+        sys_cpu_quota(tf);
+        break;
+    case SYS_shm_map:
+        /*
+         * Map a shared memory page into the caller.
+         *
+         * Parameters:
+         *   a[0]: the key of the shared page
+         *   a[1]: the page-aligned linear address to map it at
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_ID, E_INVAL_ADDR, E_EXCEEDS_QUOTA, E_MEM
+         */
+        sys_shm_map(tf);
+        break;
+    case SYS_futex_wait:
+        /*
+         * Sleep on a user word if it still holds the expected value.
+         *
+         * Parameters:
+         *   a[0]: the linear address of the word
+         *   a[1]: the expected value
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_ADDR, E_AGAIN
+         */
+        sys_futex_wait(tf);
+        break;
+    case SYS_futex_wake:
+        /*
+         * Wake up processes sleeping on a user word.
+         *
+         * Parameters:
+         *   a[0]: the linear address of the word
+         *   a[1]: the maximum number of processes to wake up
+         *
+         * Return:
+         *   the number of processes woken up
+         *
+         * Error:
+         *   E_INVAL_ADDR
+         */
+        sys_futex_wake(tf);
+        break;
+    case SYS_lockstat:
+        /*
+         * Print the kernel lock statistics, or clear them.
+         *
+         * Parameters:
+         *   a[0]: 0 to print the statistics, nonzero to clear them
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_CALLNR: the kernel is built without LOCKSTAT.
+         */
+        sys_lockstat(tf);
+        break;
 
     /** Filesystem calls **/
     case SYS_open:
@@ -103,6 +235,38 @@ void syscall_dispatch(tf_t *tf)
     case SYS_readline:
         sys_readline(tf);
         break;
+    case SYS_bufstat:
+        /*
+         * Read the buffer cache statistics, and optionally clear them.
+         *
+         * Parameters:
+         *   a[0]: nonzero to clear the lookup counters afterwards
+         *   a[1]: the user address of a struct bufstat, or 0
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_ADDR
+         */
+        sys_bufstat(tf);
+        break;
+    case SYS_logstat:
+        /*
+         * Read the log transaction statistics, and optionally clear them.
+         *
+         * Parameters:
+         *   a[0]: nonzero to clear the counters afterwards
+         *   a[1]: the user address of a struct logstat, or 0
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_INVAL_ADDR
+         */
+        sys_logstat(tf);
+        break;
     default:
         syscall_set_errno(tf, E_INVAL_CALLNR);
     }
@@ -5,6 +5,9 @@
 #include <lib/trap.h>
 #include <lib/syscall.h>
 #include <lib/string.h>
+#include <lib/spinlock.h>
+#include <lib/lockstat.h>
+#include <lib/thread.h>
 #include <dev/intr.h>
 #include <dev/console.h>
 #include <pcpu/PCPUIntro/export.h>
@@ -14,7 +17,11 @@
 
 #include "import.h"
 
-static char sys_buf[NUM_IDS][PAGESIZE];
+/**
+ * Per-process bounce page for copying system call data in and out of user
+ * space, also used by the file system calls.
+ */
+char sys_buf[NUM_IDS][PAGESIZE];
 
 /**
  * Copies a string from user into buffer and prints it to the screen.
@@ -64,6 +71,25 @@ extern uint8_t _binary___obj_user_pingpong_pong_start[];
 extern uint8_t _binary___obj_user_pingpong_ding_start[];
 extern uint8_t _binary___obj_user_fstest_fstest_start[];
 extern uint8_t _binary___obj_user_shell_shell_start[];
+extern uint8_t _binary___obj_user_bench_lockbench_start[];
+extern uint8_t _binary___obj_user_bench_lockworker_start[];
+extern uint8_t _binary___obj_user_bench_ipcbench_start[];
+extern uint8_t _binary___obj_user_bench_ipcpeer_start[];
+extern uint8_t _binary___obj_user_bench_spawnbench_start[];
+extern uint8_t _binary___obj_user_bench_spawnchild_start[];
+extern uint8_t _binary___obj_user_bench_dlbench_start[];
+extern uint8_t _binary___obj_user_bench_dltask_start[];
+extern uint8_t _binary___obj_user_bench_cpubench_start[];
+extern uint8_t _binary___obj_user_bench_cpuhog_start[];
+extern uint8_t _binary___obj_user_bench_readbench_start[];
+extern uint8_t _binary___obj_user_bench_readworker_start[];
+extern uint8_t _binary___obj_user_bench_bcachebench_start[];
+extern uint8_t _binary___obj_user_bench_mixbench_start[];
+extern uint8_t _binary___obj_user_bench_logbench_start[];
+extern uint8_t _binary___obj_user_bench_logworker_start[];
+extern uint8_t _binary___obj_user_bench_writebench_start[];
+extern uint8_t _binary___obj_user_bench_crashtest_start[];
+extern uint8_t _binary___obj_user_bench_dirbench_start[];
 
 /**
  * Spawns a new child process.
@@ -98,16 +124,6 @@ void sys_spawn(tf_t *tf)
         syscall_set_retval1(tf, NUM_IDS);
         return;
     }
-    else if (NUM_IDS < curid * MAX_CHILDREN + 1 + MAX_CHILDREN) {
-        syscall_set_errno(tf, E_MAX_NUM_CHILDEN_REACHED);
-        syscall_set_retval1(tf, NUM_IDS);
-        return;
-    }
-    else if (container_get_nchildren(curid) == MAX_CHILDREN) {
-        syscall_set_errno(tf, E_INVAL_CHILD_ID);
-        syscall_set_retval1(tf, NUM_IDS);
-        return;
-    }
 
     switch (elf_id) {
     case 1:
@@ -125,6 +141,63 @@ void sys_spawn(tf_t *tf)
     case 5:
         elf_addr = _binary___obj_user_shell_shell_start;
         break;
+    case 6:
+        elf_addr = _binary___obj_user_bench_lockbench_start;
+        break;
+    case 7:
+        elf_addr = _binary___obj_user_bench_lockworker_start;
+        break;
+    case 8:
+        elf_addr = _binary___obj_user_bench_ipcbench_start;
+        break;
+    case 9:
+        elf_addr = _binary___obj_user_bench_ipcpeer_start;
+        break;
+    case 10:
+        elf_addr = _binary___obj_user_bench_spawnbench_start;
+        break;
+    case 11:
+        elf_addr = _binary___obj_user_bench_spawnchild_start;
+        break;
+    case 12:
+        elf_addr = _binary___obj_user_bench_dlbench_start;
+        break;
+    case 13:
+        elf_addr = _binary___obj_user_bench_dltask_start;
+        break;
+    case 14:
+        elf_addr = _binary___obj_user_bench_cpubench_start;
+        break;
+    case 15:
+        elf_addr = _binary___obj_user_bench_cpuhog_start;
+        break;
+    case 16:
+        elf_addr = _binary___obj_user_bench_readbench_start;
+        break;
+    case 17:
+        elf_addr = _binary___obj_user_bench_readworker_start;
+        break;
+    case 18:
+        elf_addr = _binary___obj_user_bench_bcachebench_start;
+        break;
+    case 19:
+        elf_addr = _binary___obj_user_bench_mixbench_start;
+        break;
+    case 20:
+        elf_addr = _binary___obj_user_bench_logbench_start;
+        break;
+    case 21:
+        elf_addr = _binary___obj_user_bench_logworker_start;
+        break;
+    case 22:
+        elf_addr = _binary___obj_user_bench_writebench_start;
+        break;
+    case 23:
+        elf_addr = _binary___obj_user_bench_crashtest_start;
+        break;
+    case 24:
+        elf_addr = _binary___obj_user_bench_dirbench_start;
+        break;
     default:
         syscall_set_errno(tf, E_INVAL_PID);
         syscall_set_retval1(tf, NUM_IDS);
@@ -154,6 +227,238 @@ void sys_yield(tf_t *tf)
     syscall_set_errno(tf, E_SUCC);
 }
 
+/**
+ * Yields directly to process # [pid], lending it the rest of the caller's
+ * time slice, so that a synchronous request/response pair costs a single
+ * context switch each way. If the target is not ready to run, this falls
+ * back to an ordinary yield.
+ */
+void sys_yield_to(tf_t *tf)
+{
+    unsigned int pid = syscall_get_arg2(tf);
+
+    if (pid >= NUM_IDS) {
+        syscall_set_errno(tf, E_INVAL_PID);
+        return;
+    }
+
+    if (!thread_yield_to(pid))
+        thread_yield();
+    syscall_set_errno(tf, E_SUCC);
+}
+
+/**
+ * Puts the calling process in the deadline scheduling class with the given
+ * [runtime], [period] and relative [deadline] in milliseconds, or moves it
+ * back to the normal class if [period] is 0.
+ * Fails with E_EXCEEDS_QUOTA if admitting the process would overcommit the CPU.
+ */
+void sys_sched_deadline(tf_t *tf)
+{
+    unsigned int runtime = syscall_get_arg2(tf);
+    unsigned int period = syscall_get_arg3(tf);
+    unsigned int deadline = syscall_get_arg4(tf);
+
+    if (period != 0 && (runtime == 0 || runtime > deadline
+                        || deadline > period || period >= DL_MAX_PERIOD)) {
+        syscall_set_errno(tf, E_INVAL_ARG);
+        return;
+    }
+
+    if (!thread_set_deadline(get_curid(), runtime, period, deadline)) {
+        syscall_set_errno(tf, E_EXCEEDS_QUOTA);
+        return;
+    }
+    syscall_set_errno(tf, E_SUCC);
+}
+
+/**
+ * Returns the number of deadline misses and budget overruns of process # [pid].
+ */
+void sys_dl_stat(tf_t *tf)
+{
+    unsigned int pid = syscall_get_arg2(tf);
+
+    if (pid >= NUM_IDS) {
+        syscall_set_errno(tf, E_INVAL_PID);
+        return;
+    }
+
+    syscall_set_retval1(tf, thread_get_dl_misses(pid));
+    syscall_set_retval2(tf, thread_get_dl_overruns(pid));
+    syscall_set_errno(tf, E_SUCC);
+}
+
+/**
+ * Limits the child process # [pid] and all its descendants to [quota] ms of
+ * CPU time in every [period] ms. A [quota] of 0 lifts the limit.
+ * Only the parent may set the limit, so a process cannot raise its own.
+ */
+void sys_cpu_quota(tf_t *tf)
+{
+    unsigned int pid = syscall_get_arg2(tf);
+    unsigned int quota = syscall_get_arg3(tf);
+    unsigned int period = syscall_get_arg4(tf);
+
+    if (pid == 0 || pid >= NUM_IDS || container_get_parent(pid) != get_curid()) {
+        syscall_set_errno(tf, E_INVAL_CHILD_ID);
+        return;
+    }
+    if (quota != 0 && (period == 0 || quota > period)) {
+        syscall_set_errno(tf, E_INVAL_ARG);
+        return;
+    }
+
+    thread_set_cpu_quota(pid, quota, period);
+    syscall_set_errno(tf, E_SUCC);
+}
+
+#define NUM_SHM 16
+
+/**
+ * Physical pages backing the shared memory regions, indexed by key.
+ * A page is allocated from the quota of the first process mapping it and
+ * is never freed, so its physical address stays a stable futex key.
+ * The locks are statically zeroed, which is the unlocked state.
+ */
+static unsigned int shm_pages[NUM_SHM];
+static spinlock_t shm_lk;
+static spinlock_t futex_lk;
+
+/**
+ * Maps the shared page # [key] at the page-aligned user address [va].
+ * Every process mapping the same key sees the same physical page.
+ */
+void sys_shm_map(tf_t *tf)
+{
+    unsigned int curid = get_curid();
+    unsigned int key = syscall_get_arg2(tf);
+    unsigned int va = syscall_get_arg3(tf);
+    unsigned int page_index;
+
+    if (key >= NUM_SHM) {
+        syscall_set_errno(tf, E_INVAL_ID);
+        return;
+    }
+    if (va % PAGESIZE != 0 || !(VM_USERLO <= va && va + PAGESIZE <= VM_USERHI)) {
+        syscall_set_errno(tf, E_INVAL_ADDR);
+        return;
+    }
+
+    spinlock_acquire(&shm_lk);
+    if (shm_pages[key] == 0) {
+        page_index = container_alloc(curid);
+        if (page_index == 0) {
+            spinlock_release(&shm_lk);
+            syscall_set_errno(tf, E_EXCEEDS_QUOTA);
+            return;
+        }
+        memzero((void *) (page_index * PAGESIZE), PAGESIZE);
+        shm_pages[key] = page_index;
+    }
+    page_index = shm_pages[key];
+    spinlock_release(&shm_lk);
+
+    if (map_page(curid, va, page_index, PTE_P | PTE_W | PTE_U) == MagicNumber) {
+        syscall_set_errno(tf, E_MEM);
+        return;
+    }
+    syscall_set_errno(tf, E_SUCC);
+}
+
+/**
+ * Translates the user address [uva] of process # [pid] to the physical
+ * address used as the futex key, faulting the page in if necessary.
+ * Returns 0 if the address is not a valid, word aligned user address.
+ */
+static uintptr_t futex_key(unsigned int pid, uintptr_t uva)
+{
+    unsigned int pte;
+
+    if (uva % sizeof(uint32_t) != 0
+        || !(VM_USERLO <= uva && uva + sizeof(uint32_t) <= VM_USERHI))
+        return 0;
+
+    pte = get_ptbl_entry_by_va(pid, uva);
+    if ((pte & PTE_P) == 0) {
+        if (alloc_page(pid, uva, PTE_P | PTE_W | PTE_U) == MagicNumber)
+            return 0;
+        pte = get_ptbl_entry_by_va(pid, uva);
+    }
+
+    return (pte & 0xfffff000) + (uva % PAGESIZE);
+}
+
+/**
+ * Puts the caller to sleep on the word at user address a[0] as long as the
+ * word still holds the value a[1]. The check and the sleep are atomic with
+ * respect to sys_futex_wake, so a wakeup issued after the word is changed
+ * is never lost. Returns E_AGAIN without sleeping if the value differs.
+ */
+void sys_futex_wait(tf_t *tf)
+{
+    uintptr_t key;
+    unsigned int expected = syscall_get_arg3(tf);
+
+    key = futex_key(get_curid(), syscall_get_arg2(tf));
+    if (key == 0) {
+        syscall_set_errno(tf, E_INVAL_ADDR);
+        return;
+    }
+
+    spinlock_acquire(&futex_lk);
+    if (*(volatile uint32_t *) key != expected) {
+        spinlock_release(&futex_lk);
+        syscall_set_errno(tf, E_AGAIN);
+        return;
+    }
+    thread_sleep((void *) key, &futex_lk);
+    spinlock_release(&futex_lk);
+
+    syscall_set_errno(tf, E_SUCC);
+}
+
+/**
+ * Wakes up at most a[1] processes sleeping on the word at user address a[0],
+ * and returns the number of processes woken up.
+ */
+void sys_futex_wake(tf_t *tf)
+{
+    uintptr_t key;
+    unsigned int nwoken;
+
+    key = futex_key(get_curid(), syscall_get_arg2(tf));
+    if (key == 0) {
+        syscall_set_errno(tf, E_INVAL_ADDR);
+        syscall_set_retval1(tf, 0);
+        return;
+    }
+
+    spinlock_acquire(&futex_lk);
+    nwoken = thread_wakeup_n((void *) key, syscall_get_arg3(tf));
+    spinlock_release(&futex_lk);
+
+    syscall_set_errno(tf, E_SUCC);
+    syscall_set_retval1(tf, nwoken);
+}
+
+/**
+ * Prints the kernel lock statistics to the console, hottest locks first,
+ * or clears them if a[0] is nonzero. Only available in kernels built with
+ * LOCKSTAT.
+ */
+void sys_lockstat(tf_t *tf)
+{
+#ifdef LOCKSTAT
+    if (syscall_get_arg2(tf))
+        lockstat_reset();
+    else
+        lockstat_dump();
+    syscall_set_errno(tf, E_SUCC);
+#else
+    syscall_set_errno(tf, E_INVAL_CALLNR);
+#endif
+}
 
 void sys_dir(tf_t * tf)
 {
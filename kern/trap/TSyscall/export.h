@@ -6,6 +6,14 @@
 void sys_puts(tf_t *tf);
 void sys_spawn(tf_t *tf);
 void sys_yield(tf_t *tf);
+void sys_yield_to(tf_t *tf);
+void sys_sched_deadline(tf_t *tf);
+void sys_dl_stat(tf_t *tf);
+void sys_cpu_quota(tf_t *tf);
+void sys_shm_map(tf_t *tf);
+void sys_futex_wait(tf_t *tf);
+void sys_futex_wake(tf_t *tf);
+void sys_lockstat(tf_t *tf);
 
 void sys_dir(tf_t * tf);
 void sys_ls(tf_t *tf);
@@ -19,9 +19,24 @@ void syscall_set_retval4(tf_t *tf, unsigned int retval);
 void syscall_set_retval5(tf_t *tf, unsigned int retval);
 
 unsigned int container_can_consume(unsigned int curid, unsigned int quota);
-unsigned int container_get_nchildren(unsigned int curid);
+unsigned int container_get_parent(unsigned int id);
 unsigned int proc_create(void *elf_addr, unsigned int quota);
 void thread_yield(void);
+unsigned int thread_yield_to(unsigned int pid);
+unsigned int thread_set_deadline(unsigned int pid, unsigned int runtime,
+                                 unsigned int period, unsigned int deadline);
+void thread_set_cpu_quota(unsigned int pid, unsigned int quota, unsigned int period);
+unsigned int thread_get_dl_misses(unsigned int pid);
+unsigned int thread_get_dl_overruns(unsigned int pid);
+void thread_sleep(void *chan, spinlock_t *lk);
+unsigned int thread_wakeup_n(void *chan, unsigned int n);
+
+unsigned int container_alloc(unsigned int id);
+unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int map_page(unsigned int proc_index, unsigned int vaddr,
+                      unsigned int page_index, unsigned int perm);
+unsigned int alloc_page(unsigned int proc_index, unsigned int vaddr,
+                        unsigned int perm);
 
 #endif  /* _KERN_ */
 
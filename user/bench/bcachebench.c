@@ -0,0 +1,102 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "bcachebench.h"
+
+static char buf[BCACHEBENCH_CHUNK];
+
+static int make_file(char *path)
+{
+    int fd, i;
+
+    if ((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        return -1;
+    for (i = 0; i < BCACHEBENCH_CHUNK; i++)
+        buf[i] = 'b';
+    for (i = 0; i < BCACHEBENCH_FILESIZE; i += BCACHEBENCH_CHUNK) {
+        if (write(fd, buf, BCACHEBENCH_CHUNK) != BCACHEBENCH_CHUNK) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * Reads the first [size] bytes of the file BCACHEBENCH_PASSES times.
+ */
+static int read_prefix(char *path, int size)
+{
+    int fd, pass, off;
+
+    for (pass = 0; pass < BCACHEBENCH_PASSES; pass++) {
+        if ((fd = open(path, O_RDONLY)) < 0)
+            return -1;
+        for (off = 0; off < size; off += BCACHEBENCH_CHUNK) {
+            if (read(fd, buf, BCACHEBENCH_CHUNK) != BCACHEBENCH_CHUNK) {
+                close(fd);
+                return -1;
+            }
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+/**
+ * Buffer cache lookup benchmark. Rereads working sets of growing size
+ * from one file and reports, for each, the hit ratio of the buffer cache
+ * and the average hash chain length and cycles per lookup, as counted by
+ * the kernel. The lookup cost should stay flat while the working set
+ * grows, and the hit ratio should only drop once it outgrows the cache.
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+    char path[] = "bcfile";
+    int sizes[] = { 2048, 4096, 8192, 32768, BCACHEBENCH_FILESIZE };
+    struct bufstat st;
+    unsigned int lookups;
+    int i;
+
+    if (sys_bufstat(0, &st) != 0) {
+        printf("bcachebench: cannot read the buffer cache statistics.\n");
+        return 0;
+    }
+    printf("bcachebench: %u buffers, %u KB resident.\n",
+           st.nbuf, st.npages * 4);
+
+    if (make_file(path) != 0) {
+        printf("bcachebench: cannot create %s.\n", path);
+        return 0;
+    }
+
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++) {
+        sys_bufstat(1, 0);
+        if (read_prefix(path, sizes[i]) != 0) {
+            printf("bcachebench: short read of %s.\n", path);
+            break;
+        }
+        if (sys_bufstat(0, &st) != 0)
+            break;
+
+        lookups = st.hits + st.misses;
+        if (lookups == 0)
+            continue;
+        printf("bcachebench: %d KB: %u lookups, %u%% hits, "
+               "%u.%02u probes/lookup, %u cycles/lookup\n",
+               sizes[i] / 1024, lookups, st.hits * 100 / lookups,
+               st.probes / lookups, st.probes * 100 / lookups % 100,
+               (uint32_t) (st.cycles / lookups));
+    }
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
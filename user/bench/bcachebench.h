@@ -0,0 +1,10 @@
+#ifndef _USER_BENCH_BCACHEBENCH_H_
+#define _USER_BENCH_BCACHEBENCH_H_
+
+#define BCACHEBENCH_ELF_ID   18
+
+#define BCACHEBENCH_FILESIZE (64 * 1024)  /* bytes, within MAXFILE */
+#define BCACHEBENCH_CHUNK    512          /* bytes per read(), one block */
+#define BCACHEBENCH_PASSES   16           /* reads of each working set */
+
+#endif  /* !_USER_BENCH_BCACHEBENCH_H_ */
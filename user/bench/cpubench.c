@@ -0,0 +1,53 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "cpubench.h"
+
+/**
+ * CPU bandwidth check. Spawns CPUBENCH_NHOGS busy loops, limits the first
+ * one to CPUBENCH_QUOTA ms every CPUBENCH_PERIOD ms, and compares how much
+ * work each of them gets done in the same window.
+ */
+int main(int argc, char **argv)
+{
+    struct cpubench *cb = (struct cpubench *) CPUBENCH_SHM_VA;
+    pid_t pid;
+    uint64_t start;
+    int i;
+
+    if (sys_shm_map(CPUBENCH_SHM_KEY, cb) != 0) {
+        printf("cpubench: cannot map shared page.\n");
+        return 0;
+    }
+    memset((void *) cb, 0, sizeof(*cb));
+
+    for (i = 0; i < CPUBENCH_NHOGS; i++) {
+        if ((pid = spawn(CPUHOG_ELF_ID, 100)) == -1) {
+            printf("cpubench: failed to spawn hog %d.\n", i);
+            return 0;
+        }
+        if (i == 0 && sys_cpu_quota(pid, CPUBENCH_QUOTA, CPUBENCH_PERIOD) != 0) {
+            printf("cpubench: failed to limit hog %d.\n", pid);
+            return 0;
+        }
+    }
+
+    start = rdtsc();
+    while (rdtsc() - start < CPUBENCH_WINDOW)
+        yield();
+    cb->stop = 1;
+
+    printf("cpubench: limited hog (%d/%d ms): %u loops.\n",
+           CPUBENCH_QUOTA, CPUBENCH_PERIOD, cb->count[0]);
+    for (i = 1; i < CPUBENCH_NHOGS; i++)
+        printf("cpubench: unlimited hog: %u loops.\n", cb->count[i]);
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&cb->stop, 1);
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef _USER_BENCH_CPUBENCH_H_
+#define _USER_BENCH_CPUBENCH_H_
+
+#include <types.h>
+
+#define CPUBENCH_ELF_ID      14
+#define CPUHOG_ELF_ID        15
+
+#define CPUBENCH_SHM_KEY     3
+#define CPUBENCH_SHM_VA      0xB0003000
+
+#define CPUBENCH_NHOGS       2
+#define CPUBENCH_QUOTA       10     /* ms per period for the limited hog */
+#define CPUBENCH_PERIOD      50     /* ms */
+#define CPUBENCH_WINDOW      2000000000ULL  /* cycles to measure */
+
+/* Shared between cpubench and its hogs through CPUBENCH_SHM_KEY. */
+struct cpubench {
+    volatile uint32_t nr_hogs;  /* hands out the counter slots */
+    volatile uint32_t stop;
+    volatile uint32_t count[CPUBENCH_NHOGS];
+};
+
+#endif  /* !_USER_BENCH_CPUBENCH_H_ */
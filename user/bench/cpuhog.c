@@ -0,0 +1,23 @@
+#include <syscall.h>
+#include <x86.h>
+
+#include "cpubench.h"
+
+int main(int argc, char **argv)
+{
+    struct cpubench *cb = (struct cpubench *) CPUBENCH_SHM_VA;
+    volatile uint32_t *count;
+
+    if (sys_shm_map(CPUBENCH_SHM_KEY, cb) != 0)
+        return 0;
+    count = &cb->count[atomic_add(&cb->nr_hogs, 1)];
+
+    while (!cb->stop)
+        (*count)++;
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&cb->stop, 1);
+
+    return 0;
+}
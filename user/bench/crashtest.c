@@ -0,0 +1,139 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "crashtest.h"
+
+static char buf[CRASHTEST_WRITE];
+
+static void name(char *path, int file)
+{
+    path[2] = '0' + file;
+}
+
+/**
+ * Checks that every block of the file carries the stamp of this file and
+ * block number. Returns the number of blocks that do not, or -1 if the
+ * file cannot be read.
+ */
+static int check_file(char *path, int file, int *nblocks)
+{
+    struct crashstamp *st;
+    int fd, n, i, bad = 0, block = 0;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+    while ((n = read(fd, buf, BSIZE)) > 0) {
+        if (n != BSIZE) {
+            bad++;
+            break;
+        }
+        for (i = 0; i < BSIZE; i += sizeof(*st)) {
+            st = (struct crashstamp *) (buf + i);
+            if (st->magic != CRASHTEST_MAGIC || st->file != file
+                || st->block != block) {
+                bad++;
+                break;
+            }
+        }
+        block++;
+    }
+    close(fd);
+    *nblocks = block;
+    return bad;
+}
+
+/**
+ * Appends CRASHTEST_WRITE bytes of stamped blocks to the file, first
+ * recreating it if it has grown to CRASHTEST_FILEMAX, so that freed
+ * blocks get reused by other files.
+ */
+static int append(char *path, int file, uint32_t round)
+{
+    struct file_stat fs;
+    struct crashstamp *st;
+    int fd, i;
+    uint32_t block;
+
+    if ((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        return -1;
+    if (sys_fstat(fd, &fs) != 0)
+        goto fail;
+    if (fs.size >= CRASHTEST_FILEMAX) {
+        close(fd);
+        if (unlink(path) != 0 || (fd = open(path, O_CREATE | O_RDWR)) < 0)
+            return -1;
+        fs.size = 0;
+    }
+    block = fs.size / BSIZE;
+    for (i = 0; i < fs.size; i += CRASHTEST_WRITE) {
+        if (read(fd, buf, CRASHTEST_WRITE) != CRASHTEST_WRITE)
+            goto fail;
+    }
+
+    for (i = 0; i < CRASHTEST_WRITE; i += sizeof(*st)) {
+        st = (struct crashstamp *) (buf + i);
+        st->magic = CRASHTEST_MAGIC;
+        st->file = file;
+        st->block = block + i / BSIZE;
+        st->round = round;
+    }
+    if (write(fd, buf, CRASHTEST_WRITE) != CRASHTEST_WRITE)
+        goto fail;
+    close(fd);
+    return 0;
+
+  fail:
+    close(fd);
+    return -1;
+}
+
+/**
+ * Crash consistency test, to run in QEMU. First checks the files left by
+ * the previous run: every block within their size must hold the data
+ * written there, never zeroes, blocks of another file or stale data,
+ * whichever the journaling mode. Then keeps appending to the files, and
+ * recreating them, so that QEMU can be killed at any point; boot again
+ * and rerun the test to check what survived.
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+    char path[] = "ct0";
+    int file, bad, nbad = 0, nblocks, total = 0;
+    uint32_t round;
+
+    for (file = 0; file < CRASHTEST_NFILES; file++) {
+        name(path, file);
+        if ((bad = check_file(path, file, &nblocks)) < 0)
+            continue;
+        nbad += bad;
+        total += nblocks;
+        if (bad > 0)
+            printf("crashtest: %s: %d of %d blocks are corrupt.\n",
+                   path, bad, nblocks);
+    }
+    printf("crashtest: %d blocks checked, %s.\n", total,
+           nbad == 0 ? "consistent" : "INCONSISTENT");
+
+    printf("crashtest: writing, kill QEMU at any time and rerun.\n");
+    for (round = 0; round < CRASHTEST_ROUNDS; round++) {
+        file = round % CRASHTEST_NFILES;
+        name(path, file);
+        if (append(path, file, round) != 0) {
+            printf("crashtest: cannot append to %s.\n", path);
+            break;
+        }
+        if (round % 256 == 255)
+            printf("crashtest: %u writes done.\n", round + 1);
+    }
+    printf("crashtest: done.\n");
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
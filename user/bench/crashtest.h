@@ -0,0 +1,22 @@
+#ifndef _USER_BENCH_CRASHTEST_H_
+#define _USER_BENCH_CRASHTEST_H_
+
+#include <types.h>
+
+#define CRASHTEST_ELF_ID   23
+
+#define CRASHTEST_NFILES   8
+#define CRASHTEST_FILEMAX  (32 * 1024)  /* bytes before a file is recreated */
+#define CRASHTEST_WRITE    2048         /* bytes per write(), whole blocks */
+#define CRASHTEST_ROUNDS   4096         /* writes before the test stops */
+#define CRASHTEST_MAGIC    0x43525348   /* "CRSH" */
+
+/* Stamped over every 512-byte block the test writes. */
+struct crashstamp {
+    uint32_t magic;
+    uint32_t file;   /* which file */
+    uint32_t block;  /* block number within the file */
+    uint32_t round;  /* write that wrote it */
+};
+
+#endif  /* !_USER_BENCH_CRASHTEST_H_ */
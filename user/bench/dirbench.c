@@ -0,0 +1,107 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "dirbench.h"
+
+/**
+ * Builds "<dir>/n<i>" in path.
+ */
+static void entry_path(char *path, char *dir, int i)
+{
+    char digits[12];
+    int n = 0;
+
+    while (*dir)
+        *path++ = *dir++;
+    *path++ = '/';
+    *path++ = 'n';
+    do {
+        digits[n++] = '0' + i % 10;
+        i /= 10;
+    } while (i > 0);
+    while (n > 0)
+        *path++ = digits[--n];
+    *path = '\0';
+}
+
+/**
+ * Directory size benchmark. Fills directories of growing size with hard
+ * links to one file, so that the inode table does not limit them, then
+ * opens and unlinks every name, and reports the cycles each link, open
+ * and unlink took. With indexed directories, they should barely grow
+ * with the size of the directory.
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+    char file[] = "dbfile", dir[] = "dbdir";
+    char path[32];
+    uint64_t start, links, opens, unlinks;
+    int size, i, pass, fd;
+
+    unlink(file);
+    if ((fd = open(file, O_CREATE | O_RDWR)) < 0) {
+        printf("dirbench: cannot create %s.\n", file);
+        goto out;
+    }
+    close(fd);
+
+    for (size = 16; size <= DIRBENCH_MAXSIZE; size *= 4) {
+        if (mkdir(dir) != 0) {
+            printf("dirbench: cannot create %s.\n", dir);
+            break;
+        }
+
+        start = rdtsc();
+        for (i = 0; i < size; i++) {
+            entry_path(path, dir, i);
+            if (link(file, path) != 0) {
+                printf("dirbench: cannot link %s.\n", path);
+                goto out;
+            }
+        }
+        links = rdtsc() - start;
+
+        start = rdtsc();
+        for (pass = 0; pass < DIRBENCH_LOOKUPS; pass++) {
+            for (i = 0; i < size; i++) {
+                entry_path(path, dir, i);
+                if ((fd = open(path, O_RDONLY)) < 0) {
+                    printf("dirbench: cannot open %s.\n", path);
+                    goto out;
+                }
+                close(fd);
+            }
+        }
+        opens = rdtsc() - start;
+
+        start = rdtsc();
+        for (i = 0; i < size; i++) {
+            entry_path(path, dir, i);
+            if (unlink(path) != 0) {
+                printf("dirbench: cannot unlink %s.\n", path);
+                goto out;
+            }
+        }
+        unlinks = rdtsc() - start;
+
+        if (unlink(dir) != 0) {
+            printf("dirbench: cannot remove %s.\n", dir);
+            break;
+        }
+        printf("dirbench: %d entries: %llu cycles/link, %llu cycles/open, "
+               "%llu cycles/unlink\n", size, links / size,
+               opens / (size * DIRBENCH_LOOKUPS), unlinks / size);
+    }
+    unlink(file);
+
+  out:
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _USER_BENCH_DIRBENCH_H_
+#define _USER_BENCH_DIRBENCH_H_
+
+#define DIRBENCH_ELF_ID   24
+
+#define DIRBENCH_MAXSIZE  4096  /* most entries put in a directory */
+#define DIRBENCH_LOOKUPS  2     /* times each name is opened */
+
+#endif  /* !_USER_BENCH_DIRBENCH_H_ */
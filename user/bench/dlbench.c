@@ -0,0 +1,66 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+#include "dlbench.h"
+
+/*
+ * The first three tasks use 80% of the CPU and are admitted; the last one
+ * would overcommit it and must be refused.
+ */
+static const struct dltask params[DLBENCH_NTASKS] = {
+    { 2, 10, 10, 100000 },
+    { 3, 20, 15, 200000 },
+    { 20, 50, 50, 1000000 },
+    { 30, 50, 50, 1000000 },
+};
+
+/**
+ * Deadline class check. Spawns periodic tasks with the parameters above,
+ * waits until they finish DLBENCH_JOBS jobs each, and reports the deadline
+ * misses and budget overruns the kernel counted for every task.
+ */
+int main(int argc, char **argv)
+{
+    struct dlbench *db = (struct dlbench *) DLBENCH_SHM_VA;
+    pid_t pids[DLBENCH_NTASKS];
+    unsigned int misses, overruns;
+    int i;
+
+    if (sys_shm_map(DLBENCH_SHM_KEY, db) != 0) {
+        printf("dlbench: cannot map shared page.\n");
+        return 0;
+    }
+    memset((void *) db, 0, sizeof(*db));
+    memcpy(db->task, params, sizeof(params));
+
+    for (i = 0; i < DLBENCH_NTASKS; i++) {
+        if ((pids[i] = spawn(DLTASK_ELF_ID, 100)) == -1) {
+            printf("dlbench: failed to spawn task %d.\n", i);
+            return 0;
+        }
+    }
+
+    while (db->done < DLBENCH_NTASKS)
+        yield();
+
+    for (i = 0; i < DLBENCH_NTASKS; i++) {
+        if (db->task[i].admitted < 0) {
+            printf("dlbench: task %d (%d/%d/%d ms): refused.\n", i,
+                   params[i].runtime, params[i].period, params[i].deadline);
+            continue;
+        }
+        if (sys_dl_stat(pids[i], &misses, &overruns) != 0)
+            continue;
+        printf("dlbench: task %d (%d/%d/%d ms): %u misses, %u overruns.\n", i,
+               params[i].runtime, params[i].period, params[i].deadline,
+               misses, overruns);
+    }
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&db->done, DLBENCH_NTASKS);
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef _USER_BENCH_DLBENCH_H_
+#define _USER_BENCH_DLBENCH_H_
+
+#include <types.h>
+
+#define DLBENCH_ELF_ID       12
+#define DLTASK_ELF_ID        13
+
+#define DLBENCH_SHM_KEY      2
+#define DLBENCH_SHM_VA       0xB0002000
+
+#define DLBENCH_NTASKS       4
+#define DLBENCH_JOBS         200
+
+struct dltask {
+    uint32_t runtime;          /* ms per period */
+    uint32_t period;           /* ms */
+    uint32_t deadline;         /* ms, relative to the period start */
+    uint32_t work;             /* loop iterations per job */
+    volatile int admitted;     /* 1 admitted, -1 refused, 0 not yet known */
+};
+
+/* Shared between dlbench and its tasks through DLBENCH_SHM_KEY. */
+struct dlbench {
+    volatile uint32_t nr_tasks;  /* hands out the task slots */
+    volatile uint32_t done;      /* tasks that finished or were refused */
+    struct dltask task[DLBENCH_NTASKS];
+};
+
+#endif  /* !_USER_BENCH_DLBENCH_H_ */
@@ -0,0 +1,39 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "dlbench.h"
+
+int main(int argc, char **argv)
+{
+    struct dlbench *db = (struct dlbench *) DLBENCH_SHM_VA;
+    struct dltask *t;
+    volatile uint32_t work;
+    int job;
+
+    if (sys_shm_map(DLBENCH_SHM_KEY, db) != 0) {
+        printf("dltask: cannot map shared page.\n");
+        return 0;
+    }
+    t = &db->task[atomic_add(&db->nr_tasks, 1)];
+
+    if (sys_sched_deadline(t->runtime, t->period, t->deadline) != 0) {
+        t->admitted = -1;
+    } else {
+        t->admitted = 1;
+        /* Each yield completes a job and waits for the next period. */
+        for (job = 0; job < DLBENCH_JOBS; job++) {
+            for (work = 0; work < t->work; work++);
+            yield();
+        }
+        sys_sched_deadline(0, 0, 0);
+    }
+    atomic_add(&db->done, 1);
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&db->done, 0xffffffff);
+
+    return 0;
+}
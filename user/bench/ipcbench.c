@@ -0,0 +1,40 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+#include "ipcbench.h"
+
+/**
+ * Request/response round trip benchmark. Spawns a client and a server peer
+ * and lets them exchange IPCBENCH_ROUNDS requests, first waiting with a
+ * plain yield and then handing the CPU to each other with yield_to.
+ * The client reports the cycles spent per round trip.
+ */
+int main(int argc, char **argv)
+{
+    struct ipcbench *ib = (struct ipcbench *) IPCBENCH_SHM_VA;
+    pid_t pid;
+    int i;
+
+    if (sys_shm_map(IPCBENCH_SHM_KEY, ib) != 0) {
+        printf("ipcbench: cannot map shared page.\n");
+        return 0;
+    }
+    memset((void *) ib, 0, sizeof(*ib));
+
+    for (i = 0; i < 2; i++) {
+        if ((pid = spawn(IPCPEER_ELF_ID, 100)) == -1) {
+            printf("ipcbench: failed to spawn peer %d.\n", i);
+            return 0;
+        }
+        ib->pids[i] = pid;
+    }
+    ib->go = 1;
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&ib->go, 1);
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _USER_BENCH_IPCBENCH_H_
+#define _USER_BENCH_IPCBENCH_H_
+
+#include <types.h>
+
+#define IPCBENCH_ELF_ID      8
+#define IPCPEER_ELF_ID       9
+
+#define IPCBENCH_SHM_KEY     1
+#define IPCBENCH_SHM_VA      0xB0001000
+
+#define IPCBENCH_ROUNDS      10000
+
+#define IPC_YIELD            0   /* wait with sys_yield */
+#define IPC_YIELD_TO         1   /* wait with sys_yield_to the peer */
+#define IPC_QUIT             2
+
+#define IPC_CLIENT           0
+#define IPC_SERVER           1
+
+/* Shared between ipcbench and the two peers through IPCBENCH_SHM_KEY. */
+struct ipcbench {
+    volatile uint32_t go;        /* set once both peer pids are known */
+    volatile uint32_t nr_peers;  /* hands out the client and server roles */
+    volatile pid_t pids[2];      /* indexed by IPC_CLIENT / IPC_SERVER */
+    volatile uint32_t mode;
+    volatile uint32_t request;
+    volatile uint32_t response;
+};
+
+#endif  /* !_USER_BENCH_IPCBENCH_H_ */
@@ -0,0 +1,79 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "ipcbench.h"
+
+static void wait_for(struct ipcbench *ib, pid_t peer)
+{
+    if (ib->mode == IPC_YIELD_TO)
+        yield_to(peer);
+    else
+        yield();
+}
+
+static void client(struct ipcbench *ib)
+{
+    static const char *names[] = { "yield", "yield_to" };
+    pid_t server = ib->pids[IPC_SERVER];
+    uint64_t start, cycles;
+    uint32_t mode;
+    int i;
+
+    for (mode = IPC_YIELD; mode <= IPC_YIELD_TO; mode++) {
+        ib->mode = mode;
+        start = rdtsc();
+        for (i = 0; i < IPCBENCH_ROUNDS; i++) {
+            ib->request++;
+            while (ib->response != ib->request)
+                wait_for(ib, server);
+        }
+        cycles = rdtsc() - start;
+        printf("ipcbench: %s: %u cycles/round trip.\n",
+               names[mode], (uint32_t) (cycles / IPCBENCH_ROUNDS));
+    }
+
+    ib->mode = IPC_QUIT;
+    ib->request++;
+    printf("ipcbench: done.\n");
+}
+
+static void server(struct ipcbench *ib)
+{
+    pid_t client = ib->pids[IPC_CLIENT];
+
+    while (1) {
+        while (ib->request == ib->response)
+            wait_for(ib, client);
+        if (ib->mode == IPC_QUIT)
+            break;
+        ib->response = ib->request;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct ipcbench *ib = (struct ipcbench *) IPCBENCH_SHM_VA;
+    uint32_t role;
+
+    if (sys_shm_map(IPCBENCH_SHM_KEY, ib) != 0) {
+        printf("ipcpeer: cannot map shared page.\n");
+        return 0;
+    }
+
+    role = atomic_add(&ib->nr_peers, 1);
+    while (ib->go == 0)
+        yield();
+
+    if (role == IPC_CLIENT)
+        client(ib);
+    else
+        server(ib);
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&ib->go, 1);
+
+    return 0;
+}
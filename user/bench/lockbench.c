@@ -0,0 +1,75 @@
+#include <mutex.h>
+#include <proc.h>
+#include <spinlock.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "lockbench.h"
+
+/**
+ * Contended lock handoff benchmark. Spawns LOCKBENCH_NWORKERS workers that
+ * hammer one shared counter, first under the user spinlock and then under
+ * the futex based mutex, and reports the cycles spent per acquisition.
+ * A spinning waiter burns its whole time slice whenever the holder gets
+ * preempted inside the critical section; a mutex waiter sleeps instead.
+ */
+static uint64_t run_round(struct lockbench *lb, uint32_t mode)
+{
+    uint64_t start;
+
+    lb->counter = 0;
+    lb->done = 0;
+    lb->mode = mode;
+
+    start = rdtsc();
+    atomic_add(&lb->round, 1);
+    while (lb->done < LOCKBENCH_NWORKERS)
+        yield();
+    return rdtsc() - start;
+}
+
+int main(int argc, char **argv)
+{
+    struct lockbench *lb = (struct lockbench *) LOCKBENCH_SHM_VA;
+    static const char *names[] = { "spinlock", "mutex" };
+    uint32_t total = LOCKBENCH_NWORKERS * LOCKBENCH_ITERS;
+    uint64_t cycles;
+    uint32_t mode;
+    int i;
+
+    if (sys_shm_map(LOCKBENCH_SHM_KEY, lb) != 0) {
+        printf("lockbench: cannot map shared page.\n");
+        return 0;
+    }
+    memset((void *) lb, 0, sizeof(*lb));
+    spinlock_init(&lb->spin);
+    mutex_init(&lb->mutex);
+
+    for (i = 0; i < LOCKBENCH_NWORKERS; i++) {
+        if (spawn(LOCKWORKER_ELF_ID, 100) == -1) {
+            printf("lockbench: failed to spawn worker %d.\n", i);
+            return 0;
+        }
+    }
+
+    printf("lockbench: %d workers x %d acquisitions.\n",
+           LOCKBENCH_NWORKERS, LOCKBENCH_ITERS);
+    for (mode = LOCK_SPIN; mode <= LOCK_MUTEX; mode++) {
+        cycles = run_round(lb, mode);
+        printf("lockbench: %s: %u cycles/acquisition, counter %s.\n",
+               names[mode], (uint32_t) (cycles / total),
+               lb->counter == total ? "ok" : "CORRUPTED");
+    }
+
+    lb->mode = LOCK_QUIT;
+    atomic_add(&lb->round, 1);
+    printf("lockbench: done.\n");
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&lb->mode, LOCK_QUIT);
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef _USER_BENCH_LOCKBENCH_H_
+#define _USER_BENCH_LOCKBENCH_H_
+
+#include <mutex.h>
+#include <spinlock.h>
+#include <types.h>
+
+#define LOCKBENCH_ELF_ID     6
+#define LOCKWORKER_ELF_ID    7
+
+#define LOCKBENCH_SHM_KEY    0
+#define LOCKBENCH_SHM_VA     0xB0000000
+
+#define LOCKBENCH_NWORKERS   3
+#define LOCKBENCH_ITERS      20000
+#define LOCKBENCH_CS_WORK    50    /* loop iterations inside the critical section */
+
+#define LOCK_SPIN            0
+#define LOCK_MUTEX           1
+#define LOCK_QUIT            2
+
+/* Shared between lockbench and its workers through LOCKBENCH_SHM_KEY. */
+struct lockbench {
+    volatile uint32_t round;  /* bumped by lockbench to start a round */
+    volatile uint32_t mode;   /* LOCK_SPIN, LOCK_MUTEX or LOCK_QUIT */
+    volatile uint32_t done;   /* workers that finished the current round */
+    spinlock_t spin;
+    mutex_t mutex;
+    volatile uint32_t counter;
+};
+
+#endif  /* !_USER_BENCH_LOCKBENCH_H_ */
@@ -0,0 +1,56 @@
+#include <mutex.h>
+#include <proc.h>
+#include <spinlock.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "lockbench.h"
+
+static void critical_section(struct lockbench *lb)
+{
+    volatile uint32_t work;
+
+    for (work = 0; work < LOCKBENCH_CS_WORK; work++);
+    lb->counter++;
+}
+
+int main(int argc, char **argv)
+{
+    struct lockbench *lb = (struct lockbench *) LOCKBENCH_SHM_VA;
+    uint32_t round = 0;
+    int i;
+
+    if (sys_shm_map(LOCKBENCH_SHM_KEY, lb) != 0) {
+        printf("lockworker: cannot map shared page.\n");
+        return 0;
+    }
+
+    while (1) {
+        while (lb->round == round)
+            yield();
+        round = lb->round;
+
+        if (lb->mode == LOCK_QUIT)
+            break;
+
+        for (i = 0; i < LOCKBENCH_ITERS; i++) {
+            if (lb->mode == LOCK_SPIN) {
+                spinlock_acquire(&lb->spin);
+                critical_section(lb);
+                spinlock_release(&lb->spin);
+            } else {
+                mutex_lock(&lb->mutex);
+                critical_section(lb);
+                mutex_unlock(&lb->mutex);
+            }
+        }
+        atomic_add(&lb->done, 1);
+    }
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&lb->mode, LOCK_QUIT);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "logbench.h"
+
+/**
+ * Runs one round with the first [active] workers and returns the cycles
+ * it took.
+ */
+static uint64_t run_round(struct logbench *lb, uint32_t active)
+{
+    uint64_t start;
+
+    lb->done = 0;
+    lb->active = active;
+    start = rdtsc();
+    lb->round++;
+    while (lb->done < active)
+        yield();
+    return rdtsc() - start;
+}
+
+/**
+ * Multi-process file system update benchmark. Every worker creates,
+ * writes and removes its own files and directories, so the rounds only
+ * contend on the log. Compares one writer with LOGBENCH_NWORKERS
+ * concurrent writers: with group commit, the system calls per commit and
+ * the commits per cycle should both go up with the number of writers.
+ */
+int main(int argc, char **argv)
+{
+    struct logbench *lb = (struct logbench *) LOGBENCH_SHM_VA;
+    struct logstat st;
+    uint64_t cycles;
+    uint32_t nwriters[2] = { 1, LOGBENCH_NWORKERS };
+    int i;
+
+    if (sys_shm_map(LOGBENCH_SHM_KEY, lb) != 0) {
+        printf("logbench: cannot map shared page.\n");
+        return 0;
+    }
+    memset((void *) lb, 0, sizeof(*lb));
+
+    for (i = 0; i < LOGBENCH_NWORKERS; i++) {
+        if (spawn(LOGWORKER_ELF_ID, 100) == -1) {
+            printf("logbench: failed to spawn worker %d.\n", i);
+            return 0;
+        }
+    }
+    while (lb->ready < LOGBENCH_NWORKERS)
+        yield();
+
+    for (i = 0; i < 2; i++) {
+        sys_logstat(1, 0);
+        cycles = run_round(lb, nwriters[i]);
+        if (sys_logstat(0, &st) != 0 || st.commits == 0)
+            break;
+        printf("logbench: %d writers: %u calls, %u commits in %llu cycles, "
+               "%u calls/commit, %u commits/Gcycle\n",
+               nwriters[i], st.ops, st.commits, cycles, st.ops / st.commits,
+               (uint32_t) ((uint64_t) st.commits * 1000000000 / cycles));
+    }
+    if (lb->errors)
+        printf("logbench: %d failed updates.\n", lb->errors);
+
+    lb->active = LOG_QUIT;
+    lb->round++;
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&lb->round, lb->round);
+
+    return 0;
+}
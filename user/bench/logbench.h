@@ -0,0 +1,28 @@
+#ifndef _USER_BENCH_LOGBENCH_H_
+#define _USER_BENCH_LOGBENCH_H_
+
+#include <types.h>
+
+#define LOGBENCH_ELF_ID      20
+#define LOGWORKER_ELF_ID     21
+
+#define LOGBENCH_SHM_KEY     5
+#define LOGBENCH_SHM_VA      0xB0005000
+
+#define LOGBENCH_NWORKERS    4
+#define LOGBENCH_ITERS       16   /* mkdir/create/write/unlink rounds */
+#define LOGBENCH_CHUNK       512  /* bytes written to each file */
+
+#define LOG_QUIT             0xFFFFFFFF
+
+/* Shared between logbench and its workers through LOGBENCH_SHM_KEY. */
+struct logbench {
+    volatile uint32_t nr_workers;  /* hands out the worker slots */
+    volatile uint32_t ready;       /* workers waiting for the first round */
+    volatile uint32_t round;       /* bumped by logbench to start a round */
+    volatile uint32_t active;      /* workers taking part in this round */
+    volatile uint32_t done;        /* workers that finished the current round */
+    volatile uint32_t errors;
+};
+
+#endif  /* !_USER_BENCH_LOGBENCH_H_ */
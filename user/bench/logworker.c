@@ -0,0 +1,73 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "logbench.h"
+
+static char buf[LOGBENCH_CHUNK];
+
+/**
+ * One round of updates: makes a directory and a file, writes the file,
+ * then removes both. Each step is a transaction of its own.
+ */
+static int update(char *dir, char *path)
+{
+    int fd;
+
+    if (mkdir(dir) != 0)
+        return -1;
+    if ((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        return -1;
+    if (write(fd, buf, LOGBENCH_CHUNK) != LOGBENCH_CHUNK) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    if (unlink(path) != 0 || unlink(dir) != 0)
+        return -1;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct logbench *lb = (struct logbench *) LOGBENCH_SHM_VA;
+    char dir[] = "lbdir0", path[] = "lbfile0";
+    uint32_t round = 0;
+    int slot, i;
+
+    if (sys_shm_map(LOGBENCH_SHM_KEY, lb) != 0) {
+        printf("logworker: cannot map shared page.\n");
+        return 0;
+    }
+    slot = atomic_add(&lb->nr_workers, 1);
+    dir[5] = '0' + slot;
+    path[6] = '0' + slot;
+    for (i = 0; i < LOGBENCH_CHUNK; i++)
+        buf[i] = 'a' + slot;
+    atomic_add(&lb->ready, 1);
+
+    while (1) {
+        while (lb->round == round)
+            yield();
+        round = lb->round;
+
+        if (lb->active == LOG_QUIT)
+            break;
+        if (slot >= lb->active)
+            continue;
+
+        for (i = 0; i < LOGBENCH_ITERS; i++) {
+            if (update(dir, path) != 0)
+                atomic_add(&lb->errors, 1);
+        }
+        atomic_add(&lb->done, 1);
+    }
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&lb->active, LOG_QUIT);
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "mixbench.h"
+
+static char buf[MIXBENCH_CHUNK];
+
+/**
+ * Fills in the two digits at the end of path with i.
+ */
+static char *name(char *path, int i)
+{
+    int len = strlen(path);
+
+    path[len - 2] = '0' + i / 10 % 10;
+    path[len - 1] = '0' + i % 10;
+    return path;
+}
+
+static int make_file(char *path, int size)
+{
+    int fd, i;
+
+    if ((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        return -1;
+    for (i = 0; i < MIXBENCH_CHUNK; i++)
+        buf[i] = 'm';
+    for (i = 0; i < size; i += MIXBENCH_CHUNK) {
+        if (write(fd, buf, MIXBENCH_CHUNK) != MIXBENCH_CHUNK) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * Reads every streamed file once, from start to end.
+ */
+static int stream(void)
+{
+    char path[] = "mix/s00";
+    int fd, i, off;
+
+    for (i = 0; i < MIXBENCH_NSTREAM; i++) {
+        if ((fd = open(name(path, i), O_RDONLY)) < 0)
+            return -1;
+        for (off = 0; off < MIXBENCH_FILESIZE; off += MIXBENCH_CHUNK) {
+            if (read(fd, buf, MIXBENCH_CHUNK) != MIXBENCH_CHUNK) {
+                close(fd);
+                return -1;
+            }
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+/**
+ * Opens and stats every small file: path lookups and inode reads only.
+ */
+static int lookup(void)
+{
+    char path[] = "mix/m00";
+    struct file_stat st;
+    int fd, i;
+
+    for (i = 0; i < MIXBENCH_NMETA; i++) {
+        if ((fd = open(name(path, i), O_RDONLY)) < 0)
+            return -1;
+        if (sys_fstat(fd, &st) != 0) {
+            close(fd);
+            return -1;
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+static void report(char *phase, int round, struct bufstat *st)
+{
+    unsigned int lookups = st->hits + st->misses;
+    unsigned int meta = st->meta_hits + st->meta_misses;
+
+    printf("mixbench: round %d %s: %u lookups, %u%% hits; "
+           "%u metadata lookups, %u%% hits\n", round, phase,
+           lookups, lookups ? st->hits * 100 / lookups : 0,
+           meta, meta ? st->meta_hits * 100 / meta : 0);
+}
+
+/**
+ * Mixed buffer cache benchmark. Streams files larger than the cache
+ * through it, each pass followed by lookups of small files, and reports
+ * the hit ratios of both as counted by the kernel. With a scan-resistant
+ * cache the lookups should keep hitting after every stream. The default
+ * cache holds the whole stream; build the kernel with a small
+ * BUFCACHE_PAGES, such as 32, for the stream to outgrow it.
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+    char mpath[] = "mix/m00", spath[] = "mix/s00";
+    struct bufstat st;
+    int i;
+
+    if (sys_bufstat(0, &st) != 0) {
+        printf("mixbench: cannot read the buffer cache statistics.\n");
+        return 0;
+    }
+    printf("mixbench: %u buffers, %u KB resident, %d KB streamed.\n",
+           st.nbuf, st.npages * 4,
+           MIXBENCH_NSTREAM * MIXBENCH_FILESIZE / 1024);
+    if (st.nbuf * MIXBENCH_CHUNK >= MIXBENCH_NSTREAM * MIXBENCH_FILESIZE)
+        printf("mixbench: the stream fits in the cache, "
+               "set BUFCACHE_PAGES lower.\n");
+
+    mkdir("mix");
+    for (i = 0; i < MIXBENCH_NMETA; i++) {
+        if (make_file(name(mpath, i), 0) != 0) {
+            printf("mixbench: cannot create %s.\n", mpath);
+            goto out;
+        }
+    }
+    for (i = 0; i < MIXBENCH_NSTREAM; i++) {
+        if (make_file(name(spath, i), MIXBENCH_FILESIZE) != 0) {
+            printf("mixbench: cannot create %s.\n", spath);
+            goto out;
+        }
+    }
+
+    /* Warm the metadata up. */
+    lookup();
+
+    for (i = 0; i < MIXBENCH_ROUNDS; i++) {
+        sys_bufstat(1, 0);
+        if (stream() != 0) {
+            printf("mixbench: short read of the stream.\n");
+            break;
+        }
+        sys_bufstat(0, &st);
+        report("stream", i, &st);
+
+        sys_bufstat(1, 0);
+        if (lookup() != 0) {
+            printf("mixbench: cannot look the small files up.\n");
+            break;
+        }
+        sys_bufstat(0, &st);
+        report("lookups", i, &st);
+    }
+
+  out:
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef _USER_BENCH_MIXBENCH_H_
+#define _USER_BENCH_MIXBENCH_H_
+
+#define MIXBENCH_ELF_ID   19
+
+#define MIXBENCH_NMETA    32           /* empty files looked up by path */
+#define MIXBENCH_NSTREAM  16           /* files streamed through the cache */
+#define MIXBENCH_FILESIZE (64 * 1024)  /* bytes per streamed file */
+#define MIXBENCH_CHUNK    512          /* bytes per read(), one block */
+#define MIXBENCH_ROUNDS   4            /* streams, each followed by lookups */
+
+#endif  /* !_USER_BENCH_MIXBENCH_H_ */
@@ -0,0 +1,77 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "readbench.h"
+
+/**
+ * Runs one round with the first [active] workers, each reading its own
+ * file READBENCH_PASSES times, and returns the cycles it took.
+ */
+static uint64_t run_round(struct readbench *rb, uint32_t active)
+{
+    uint64_t start;
+
+    rb->done = 0;
+    rb->active = active;
+    start = rdtsc();
+    rb->round++;
+    while (rb->done < active)
+        yield();
+    return rdtsc() - start;
+}
+
+/**
+ * Multi-process file read benchmark. Every worker reads a different file,
+ * so the rounds only contend on the shared buffer cache and the disk.
+ * Compares the aggregate throughput of one reader with that of
+ * READBENCH_NWORKERS concurrent readers.
+ */
+int main(int argc, char **argv)
+{
+    struct readbench *rb = (struct readbench *) READBENCH_SHM_VA;
+    uint64_t cycles;
+    uint32_t nreaders[2] = { 1, READBENCH_NWORKERS };
+    uint32_t bytes;
+    int i;
+
+    if (sys_shm_map(READBENCH_SHM_KEY, rb) != 0) {
+        printf("readbench: cannot map shared page.\n");
+        return 0;
+    }
+    memset((void *) rb, 0, sizeof(*rb));
+
+    for (i = 0; i < READBENCH_NWORKERS; i++) {
+        if (spawn(READWORKER_ELF_ID, 100) == -1) {
+            printf("readbench: failed to spawn worker %d.\n", i);
+            return 0;
+        }
+    }
+    while (rb->ready < READBENCH_NWORKERS)
+        yield();
+    if (rb->errors) {
+        printf("readbench: workers failed to create their files.\n");
+        return 0;
+    }
+
+    for (i = 0; i < 2; i++) {
+        cycles = run_round(rb, nreaders[i]);
+        bytes = nreaders[i] * READBENCH_PASSES * READBENCH_FILESIZE;
+        printf("readbench: %d readers: %u bytes in %llu cycles, %u bytes/Mcycle\n",
+               nreaders[i], bytes, cycles,
+               (uint32_t) ((uint64_t) bytes * 1000000 / cycles));
+    }
+    if (rb->errors)
+        printf("readbench: %d short reads.\n", rb->errors);
+
+    rb->active = READ_QUIT;
+    rb->round++;
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&rb->round, rb->round);
+
+    return 0;
+}
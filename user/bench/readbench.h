@@ -0,0 +1,29 @@
+#ifndef _USER_BENCH_READBENCH_H_
+#define _USER_BENCH_READBENCH_H_
+
+#include <types.h>
+
+#define READBENCH_ELF_ID     16
+#define READWORKER_ELF_ID    17
+
+#define READBENCH_SHM_KEY    4
+#define READBENCH_SHM_VA     0xB0004000
+
+#define READBENCH_NWORKERS   4
+#define READBENCH_FILESIZE   (64 * 1024)  /* bytes per worker file */
+#define READBENCH_CHUNK      4096         /* bytes per read() */
+#define READBENCH_PASSES     8            /* reads of the whole file per round */
+
+#define READ_QUIT            0xFFFFFFFF
+
+/* Shared between readbench and its workers through READBENCH_SHM_KEY. */
+struct readbench {
+    volatile uint32_t nr_workers;  /* hands out the worker slots */
+    volatile uint32_t ready;       /* workers that created their file */
+    volatile uint32_t round;       /* bumped by readbench to start a round */
+    volatile uint32_t active;      /* workers taking part in this round */
+    volatile uint32_t done;        /* workers that finished the current round */
+    volatile uint32_t errors;
+};
+
+#endif  /* !_USER_BENCH_READBENCH_H_ */
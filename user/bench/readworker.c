@@ -0,0 +1,84 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "readbench.h"
+
+static char buf[READBENCH_CHUNK];
+
+/**
+ * Writes this worker's own file of READBENCH_FILESIZE bytes.
+ */
+static int make_file(char *path, int slot)
+{
+    int fd, i;
+
+    if ((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        return -1;
+    for (i = 0; i < READBENCH_CHUNK; i++)
+        buf[i] = 'a' + slot;
+    for (i = 0; i < READBENCH_FILESIZE; i += READBENCH_CHUNK) {
+        if (write(fd, buf, READBENCH_CHUNK) != READBENCH_CHUNK) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+static int read_file(char *path)
+{
+    int fd, n, total = 0;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+    while ((n = read(fd, buf, READBENCH_CHUNK)) > 0)
+        total += n;
+    close(fd);
+    return total == READBENCH_FILESIZE ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct readbench *rb = (struct readbench *) READBENCH_SHM_VA;
+    char path[] = "rbfile0";
+    uint32_t round = 0;
+    int slot, i;
+
+    if (sys_shm_map(READBENCH_SHM_KEY, rb) != 0) {
+        printf("readworker: cannot map shared page.\n");
+        return 0;
+    }
+    slot = atomic_add(&rb->nr_workers, 1);
+    path[6] = '0' + slot;
+
+    if (make_file(path, slot) != 0)
+        atomic_add(&rb->errors, 1);
+    atomic_add(&rb->ready, 1);
+
+    while (1) {
+        while (rb->round == round)
+            yield();
+        round = rb->round;
+
+        if (rb->active == READ_QUIT)
+            break;
+        if (slot >= rb->active)
+            continue;
+
+        for (i = 0; i < READBENCH_PASSES; i++) {
+            if (read_file(path) != 0)
+                atomic_add(&rb->errors, 1);
+        }
+        atomic_add(&rb->done, 1);
+    }
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&rb->active, READ_QUIT);
+
+    return 0;
+}
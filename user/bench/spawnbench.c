@@ -0,0 +1,46 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+
+#include "spawnbench.h"
+
+/**
+ * Spawn rate benchmark. Keeps spawning minimal children in batches of
+ * SPAWNBENCH_BATCH until either the process ids or the caller's quota run
+ * out, and reports the cycles spent per spawn for every batch.
+ * Launch it with enough quota for thousands of children, e.g.
+ * "spawn 10 40000".
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+    uint64_t start, cycles;
+    int nspawned, i;
+
+    printf("spawnbench: %d pages per child.\n", SPAWNBENCH_QUOTA);
+
+    nspawned = 0;
+    while (1) {
+        start = rdtsc();
+        for (i = 0; i < SPAWNBENCH_BATCH; i++) {
+            if (spawn(SPAWNCHILD_ELF_ID, SPAWNBENCH_QUOTA) == -1)
+                break;
+        }
+        cycles = rdtsc() - start;
+        nspawned += i;
+
+        if (i > 0)
+            printf("spawnbench: %d processes, %u cycles/spawn.\n",
+                   nspawned, (uint32_t) (cycles / i));
+        if (i < SPAWNBENCH_BATCH)
+            break;
+    }
+    printf("spawnbench: done, %d processes spawned.\n", nspawned);
+
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef _USER_BENCH_SPAWNBENCH_H_
+#define _USER_BENCH_SPAWNBENCH_H_
+
+#define SPAWNBENCH_ELF_ID    10
+#define SPAWNCHILD_ELF_ID    11
+
+#define SPAWNBENCH_BATCH     256
+#define SPAWNBENCH_QUOTA     8     /* pages per child: text, stack, page tables */
+
+#endif  /* !_USER_BENCH_SPAWNBENCH_H_ */
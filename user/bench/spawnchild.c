@@ -0,0 +1,16 @@
+#include <syscall.h>
+#include <types.h>
+
+/**
+ * Child of spawnbench. Goes to sleep right away so that thousands of them
+ * neither spin nor crowd the ready queue.
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <proc.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+
+#include "writebench.h"
+
+static char buf[WRITEBENCH_MAXCHUNK];
+
+/**
+ * Writes a fresh file of WRITEBENCH_FILESIZE bytes, [chunk] bytes per
+ * write() call.
+ */
+static int write_file(char *path, int chunk)
+{
+    int fd, off;
+
+    unlink(path);
+    if ((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        return -1;
+    for (off = 0; off < WRITEBENCH_FILESIZE; off += chunk) {
+        if (write(fd, buf, chunk) != chunk) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * Bulk write benchmark. Writes files with write() calls of growing size
+ * and reports the throughput along with the transactions the log
+ * committed, as counted by the kernel. A write() is split into as few
+ * transactions as the log can hold, so compare the runs of kernels built
+ * with several LOG_CAPACITY values, or booted from images with several
+ * log sizes.
+ */
+int main(int argc, char **argv)
+{
+    static volatile uint32_t park;
+    char path[] = "wbfile";
+    int chunks[] = { 512, 4096, 16384, WRITEBENCH_MAXCHUNK };
+    struct logstat st;
+    uint64_t start, cycles;
+    uint32_t bytes;
+    int i, pass;
+
+    if (sys_logstat(0, &st) != 0) {
+        printf("writebench: cannot read the log statistics.\n");
+        return 0;
+    }
+    printf("writebench: transactions of up to %u blocks.\n", st.capacity);
+    for (i = 0; i < WRITEBENCH_MAXCHUNK; i++)
+        buf[i] = 'w';
+
+    for (i = 0; i < (int) (sizeof(chunks) / sizeof(chunks[0])); i++) {
+        sys_logstat(1, 0);
+        start = rdtsc();
+        for (pass = 0; pass < WRITEBENCH_PASSES; pass++) {
+            if (write_file(path, chunks[i]) != 0) {
+                printf("writebench: cannot write %s.\n", path);
+                goto out;
+            }
+        }
+        cycles = rdtsc() - start;
+        if (sys_logstat(0, &st) != 0 || st.commits == 0)
+            break;
+
+        bytes = WRITEBENCH_PASSES * WRITEBENCH_FILESIZE;
+        printf("writebench: %d B writes: %u bytes in %llu cycles, "
+               "%u bytes/Mcycle, %u commits, %u blocks/commit\n",
+               chunks[i], bytes, cycles,
+               (uint32_t) ((uint64_t) bytes * 1000000 / cycles),
+               st.commits, st.blocks / st.commits);
+    }
+
+  out:
+    /* Sleep for good rather than spin in entry.S after main returns. */
+    while (1)
+        sys_futex_wait(&park, 0);
+
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef _USER_BENCH_WRITEBENCH_H_
+#define _USER_BENCH_WRITEBENCH_H_
+
+#define WRITEBENCH_ELF_ID    22
+
+#define WRITEBENCH_FILESIZE  (64 * 1024)  /* bytes, within MAXFILE */
+#define WRITEBENCH_MAXCHUNK  (64 * 1024)  /* largest write() */
+#define WRITEBENCH_PASSES    4            /* files written per chunk size */
+
+#endif  /* !_USER_BENCH_WRITEBENCH_H_ */
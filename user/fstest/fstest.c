@@ -7,6 +7,10 @@
 
 #define exit(...) return __VA_ARGS__
 
+// Blocks of the big file: past the single indirect block, into the
+// double indirect ones. MAXFILE itself is over a gigabyte.
+#define BIGFILE (NDIRECT + 2 * NINDIRECT)
+
 char buf[8192];
 char name[3];
 char *echoargv[] = { "echo", "ALL", "TESTS", "PASSED", 0 };
@@ -73,7 +77,7 @@ void bigfile1(void)
         exit();
     }
 
-    for (i = 0; i < MAXFILE; i++) {
+    for (i = 0; i < BIGFILE; i++) {
         ((int *) buf)[0] = i;
         if (write(fd, buf, 512) != 512) {
             printf("error: write big file failed\n", i);
@@ -93,7 +97,7 @@ void bigfile1(void)
     for (;;) {
         i = read(fd, buf, 512);
         if (i == 0) {
-            if (n == MAXFILE - 1) {
+            if (n != BIGFILE) {
                 printf("read only %d blocks from big", n);
                 exit();
             }
@@ -10,9 +10,11 @@ struct file_stat {
 };
 
 #define BSIZE     512            // block size
-#define NDIRECT   12
+#define NDIRECT   10
 #define NINDIRECT (BSIZE / sizeof(uint32_t))
-#define MAXFILE   (NDIRECT + NINDIRECT)
+#define NLEVELS   3  // single, double and triple indirect blocks
+#define MAXFILE   (NDIRECT + NINDIRECT + NINDIRECT * NINDIRECT \
+                   + NINDIRECT * NINDIRECT * NINDIRECT)
 
 struct inode {
     uint32_t dev;   // Device number
@@ -25,7 +27,7 @@ struct inode {
     int16_t minor;
     int16_t nlink;
     uint32_t size;
-    uint32_t addrs[NDIRECT + 1];
+    uint32_t addrs[NDIRECT + NLEVELS];
 };
 
 struct file {
@@ -0,0 +1,30 @@
+#ifndef _USER_MUTEX_H_
+#define _USER_MUTEX_H_
+
+#include <types.h>
+
+/*
+ * Blocking mutex and condition variable built on sys_futex_wait and
+ * sys_futex_wake. Futexes are keyed by physical address, so both work
+ * between processes when placed in a page mapped with sys_shm_map.
+ */
+
+typedef struct {
+    volatile uint32_t state;  /* 0: unlocked, 1: locked, 2: locked, contended */
+} mutex_t;
+
+typedef struct {
+    volatile uint32_t seq;    /* bumped on every signal/broadcast */
+} cond_t;
+
+void mutex_init(mutex_t *m);
+void mutex_lock(mutex_t *m);
+bool mutex_trylock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+
+void cond_init(cond_t *c);
+void cond_wait(cond_t *c, mutex_t *m);
+void cond_signal(cond_t *c);
+void cond_broadcast(cond_t *c);
+
+#endif  /* !_USER_MUTEX_H_ */
@@ -5,5 +5,6 @@
 
 pid_t spawn(unsigned int elf_id, unsigned int quota);
 void yield(void);
+int yield_to(pid_t pid);
 
 #endif  /* !_USER_PROC_H_ */
@@ -12,6 +12,10 @@ int shell_cat(int argc, char **argv);
 int shell_touch(int argc, char **argv);
 int shell_write(int argc, char **argv);
 int shell_append(int argc, char **argv);
+int shell_spawn(int argc, char **argv);
+int shell_lockstat(int argc, char **argv);
+int shell_bufstat(int argc, char **argv);
+int shell_logstat(int argc, char **argv);
 int run_command (char *buf);
 
 int is_dir(char * path);
@@ -44,6 +44,164 @@ static gcc_inline void sys_yield(void)
                   : "cc", "memory");
 }
 
+static gcc_inline int sys_yield_to(pid_t pid)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_yield_to),
+                    "b" (pid)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_sched_deadline(unsigned int runtime, unsigned int period,
+                                         unsigned int deadline)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_sched_deadline),
+                    "b" (runtime),
+                    "c" (period),
+                    "d" (deadline)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_dl_stat(pid_t pid, unsigned int *misses,
+                                  unsigned int *overruns)
+{
+    int errno;
+    unsigned int nmiss, nover;
+
+    asm volatile ("int %3"
+                  : "=a" (errno), "=b" (nmiss), "=c" (nover)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_dl_stat),
+                    "b" (pid)
+                  : "cc", "memory");
+
+    if (errno)
+        return -1;
+    *misses = nmiss;
+    *overruns = nover;
+    return 0;
+}
+
+static gcc_inline int sys_cpu_quota(pid_t pid, unsigned int quota,
+                                    unsigned int period)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_cpu_quota),
+                    "b" (pid),
+                    "c" (quota),
+                    "d" (period)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_shm_map(unsigned int key, void *va)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_shm_map),
+                    "b" (key),
+                    "c" (va)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_futex_wait(volatile uint32_t *addr, uint32_t expected)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_futex_wait),
+                    "b" (addr),
+                    "c" (expected)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_futex_wake(volatile uint32_t *addr, unsigned int n)
+{
+    int errno;
+    int nwoken;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (nwoken)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_futex_wake),
+                    "b" (addr),
+                    "c" (n)
+                  : "cc", "memory");
+
+    return errno ? -1 : nwoken;
+}
+
+static gcc_inline int sys_lockstat(unsigned int reset)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_lockstat),
+                    "b" (reset)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_bufstat(unsigned int reset, struct bufstat *stat)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_bufstat),
+                    "b" (reset),
+                    "c" (stat)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_logstat(unsigned int reset, struct logstat *stat)
+{
+    int errno;
+
+    asm volatile ("int %1"
+                  : "=a" (errno)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_logstat),
+                    "b" (reset),
+                    "c" (stat)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
 static gcc_inline int sys_read(int fd, char *buf, size_t n)
 {
     int errno;
@@ -5,7 +5,7 @@
 #include <types.h>
 #include <string.h>
 
-#define NUM_IDS  64
+#define NUM_IDS  4096
 #define PAGESIZE 4096
 
 /* PAT */
@@ -276,6 +276,42 @@ static gcc_inline void smp_rmb(void)
     __asm __volatile ("" ::: "memory");
 }
 
+static gcc_inline uint32_t xchg(volatile uint32_t *addr, uint32_t newval)
+{
+    uint32_t result;
+
+    __asm __volatile ("lock; xchgl %0, %1"
+                      : "+m" (*addr), "=a" (result)
+                      : "1" (newval)
+                      : "cc");
+    return result;
+}
+
+static gcc_inline uint32_t cmpxchg(volatile uint32_t *addr, uint32_t oldval,
+                                   uint32_t newval)
+{
+    uint32_t result;
+
+    __asm __volatile ("lock; cmpxchgl %2, %0"
+                      : "+m" (*addr), "=a" (result)
+                      : "r" (newval), "a" (oldval)
+                      : "memory", "cc");
+    return result;
+}
+
+static gcc_inline uint32_t atomic_add(volatile uint32_t *addr, uint32_t val)
+{
+    __asm __volatile ("lock; xaddl %0, %1"
+                      : "+r" (val), "+m" (*addr)
+                      :: "memory", "cc");
+    return val;
+}
+
+static gcc_inline void pause(void)
+{
+    __asm __volatile ("pause" ::: "memory");
+}
+
 static gcc_inline uint64_t rdtsc(void)
 {
     uint64_t rv;
@@ -0,0 +1,81 @@
+#include <mutex.h>
+#include <syscall.h>
+#include <types.h>
+#include <x86.h>
+
+#define MUTEX_SPINS 100
+
+void mutex_init(mutex_t *m)
+{
+    m->state = 0;
+}
+
+bool mutex_trylock(mutex_t *m)
+{
+    return cmpxchg(&m->state, 0, 1) == 0;
+}
+
+/**
+ * Spin briefly in case the holder is about to release the lock, then mark
+ * the lock contended and sleep in the kernel until the holder wakes us.
+ */
+void mutex_lock(mutex_t *m)
+{
+    uint32_t c;
+    int i;
+
+    for (i = 0; i < MUTEX_SPINS; i++) {
+        if ((c = cmpxchg(&m->state, 0, 1)) == 0)
+            return;
+        pause();
+    }
+
+    if (c != 2)
+        c = xchg(&m->state, 2);
+    while (c != 0) {
+        sys_futex_wait(&m->state, 2);
+        c = xchg(&m->state, 2);
+    }
+}
+
+/**
+ * Only enter the kernel when someone may be sleeping on the lock.
+ */
+void mutex_unlock(mutex_t *m)
+{
+    if (xchg(&m->state, 0) == 2)
+        sys_futex_wake(&m->state, 1);
+}
+
+void cond_init(cond_t *c)
+{
+    c->seq = 0;
+}
+
+/**
+ * The sequence number is sampled before the mutex is dropped, so a signal
+ * sent in between makes sys_futex_wait return immediately instead of being
+ * lost. The mutex is retaken as contended since other waiters may exist.
+ */
+void cond_wait(cond_t *c, mutex_t *m)
+{
+    uint32_t seq = c->seq;
+
+    mutex_unlock(m);
+    sys_futex_wait(&c->seq, seq);
+
+    while (xchg(&m->state, 2) != 0)
+        sys_futex_wait(&m->state, 2);
+}
+
+void cond_signal(cond_t *c)
+{
+    atomic_add(&c->seq, 1);
+    sys_futex_wake(&c->seq, 1);
+}
+
+void cond_broadcast(cond_t *c)
+{
+    atomic_add(&c->seq, 1);
+    sys_futex_wake(&c->seq, 0xffffffff);
+}
@@ -11,3 +11,8 @@ void yield(void)
 {
     sys_yield();
 }
+
+int yield_to(pid_t pid)
+{
+    return sys_yield_to(pid);
+}
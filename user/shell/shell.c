@@ -2,6 +2,7 @@
 #include <syscall.h>
 #include <x86.h>
 #include <shell.h>
+#include <stdlib.h>
 
 struct Command
 {
@@ -9,12 +10,12 @@ struct Command
 	int (*func) (int argc, char** argv);
 };
 
-static struct Command cmds[] = {{"ls", ls}, {"pwd", pwd}, {"cd", cd}, {"cp", cp}, {"mv", mv}, {"rm", rm}, {"mkdir", shell_mkdir}, {"cat", shell_cat}, {"touch", shell_touch}, {"write", shell_write}, {"append", shell_append}};
+static struct Command cmds[] = {{"ls", ls}, {"pwd", pwd}, {"cd", cd}, {"cp", cp}, {"mv", mv}, {"rm", rm}, {"mkdir", shell_mkdir}, {"cat", shell_cat}, {"touch", shell_touch}, {"write", shell_write}, {"append", shell_append}, {"spawn", shell_spawn}, {"lockstat", shell_lockstat}, {"bufstat", shell_bufstat}, {"logstat", shell_logstat}};
 
 #define BUFFERLEN 1024
 #define PARSESPACE "\t\r\n "
 #define MAXARGS 16
-#define NUMCOMMANDS 11
+#define NUMCOMMANDS 15
 char shell_buf[BUFFERLEN];
 
 int dir_list(char* buf, char * path){
@@ -438,6 +439,100 @@ int get_filename(char* path, char* filename) {
   return n - pos - 1;
 }
 
+int shell_spawn(int argc, char** argv)
+{
+  int elf_id, quota;
+  pid_t pid;
+
+  if (argc < 2 || argc > 3) {
+    printf("usage: spawn <elf_id> [quota]\n");
+    return 0;
+  }
+  if (atoi(argv[1], &elf_id) == 0) {
+    printf("spawn: bad elf id '%s'\n", argv[1]);
+    return 0;
+  }
+  quota = 1000;
+  if (argc == 3 && atoi(argv[2], &quota) == 0) {
+    printf("spawn: bad quota '%s'\n", argv[2]);
+    return 0;
+  }
+
+  if ((pid = spawn(elf_id, quota)) == -1)
+    printf("spawn: failed to launch elf %d\n", elf_id);
+  else
+    printf("spawn: elf %d in process %d\n", elf_id, pid);
+  return 0;
+}
+
+int shell_lockstat(int argc, char** argv)
+{
+  unsigned int reset = 0;
+
+  if (argc == 2 && strcmp(argv[1], "reset") == 0)
+    reset = 1;
+  else if (argc != 1) {
+    printf("usage: lockstat [reset]\n");
+    return 0;
+  }
+
+  if (sys_lockstat(reset) == -1)
+    printf("lockstat: kernel built without LOCKSTAT\n");
+  return 0;
+}
+
+int shell_bufstat(int argc, char** argv)
+{
+  struct bufstat st;
+  unsigned int reset = 0, lookups, meta;
+
+  if (argc == 2 && strcmp(argv[1], "reset") == 0)
+    reset = 1;
+  else if (argc != 1) {
+    printf("usage: bufstat [reset]\n");
+    return 0;
+  }
+
+  if (sys_bufstat(reset, &st) == -1) {
+    printf("bufstat: failed\n");
+    return 0;
+  }
+  lookups = st.hits + st.misses;
+  printf("bufstat: %u buffers, %u KB resident\n", st.nbuf, st.npages * 4);
+  printf("bufstat: %u lookups, %u hits, %u%% hit ratio, %u waits\n", lookups,
+         st.hits, lookups ? st.hits * 100 / lookups : 0, st.waits);
+  meta = st.meta_hits + st.meta_misses;
+  printf("bufstat: %u metadata lookups, %u%% hit ratio\n", meta,
+         meta ? st.meta_hits * 100 / meta : 0);
+  return 0;
+}
+
+int shell_logstat(int argc, char** argv)
+{
+  struct logstat st;
+  unsigned int reset = 0;
+
+  if (argc == 2 && strcmp(argv[1], "reset") == 0)
+    reset = 1;
+  else if (argc != 1) {
+    printf("usage: logstat [reset]\n");
+    return 0;
+  }
+
+  if (sys_logstat(reset, &st) == -1) {
+    printf("logstat: failed\n");
+    return 0;
+  }
+  printf("logstat: transactions of up to %u blocks\n", st.capacity);
+  printf("logstat: %u system calls, %u commits, %u blocks, %u waits, "
+         "%u checkpoints\n", st.ops, st.commits, st.blocks, st.waits,
+         st.checkpoints);
+  if (st.commits > 0)
+    printf("logstat: %u calls/commit, %u blocks/commit\n",
+           st.ops / st.commits, st.blocks / st.commits);
+  return 0;
+}
+
 int run_command(char *buf)
 {
 	int argc;